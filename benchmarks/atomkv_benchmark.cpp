@@ -22,9 +22,11 @@ static std::string_view FLAGS_benchmarks =
     //"readseq,"
     //"fillsync,"
     //"fillseqbatch,"
+    //"fillseqwritebatch,"
     //"fillrandom,"
     //"readrandom,"
     "fillrandbatch,"
+    //"fillrandwritebatch,"
     //"readrandbatch,"
     //"overwrite,"
     //"overwritebatch,"
@@ -177,10 +179,14 @@ public:
                 Write(true, SEQUENTIAL, FRESH, seq_key_, seq_value_, num_ / 100, 1);
             } else if(name == "fillseqbatch") {
                 Write(write_sync, SEQUENTIAL, FRESH, seq_key_, seq_value_, num_, 1000000);
+            } else if(name == "fillseqwritebatch") {
+                BatchWrite(write_sync, SEQUENTIAL, FRESH, seq_key_, seq_value_, num_, 1000000);
             } else if (name == "fillrandom") {
                 Write(write_sync, RANDOM, FRESH, rand_key_, rand_value_, num_ / 100, 1);
             } else if (name == "fillrandbatch") {
                 Write(write_sync, RANDOM, FRESH, rand_key_, rand_value_, num_, num_);
+            } else if (name == "fillrandwritebatch") {
+                BatchWrite(write_sync, RANDOM, FRESH, rand_key_, rand_value_, num_, num_);
             } else if (name == "overwrite") {
                 Write(write_sync, RANDOM, EXISTING, rand_key_, rand_value_, num_ / 100, 1);
             } else if (name == "overwritebatch") {
@@ -224,6 +230,26 @@ public:
         }
     }
 
+    // Like Write, but each transaction applies its entries through one WriteBatch
+    void BatchWrite(bool write_sync, Order order, DBState db_state, const std::vector<std::string>& key, const std::vector<std::string>& value, int num_entries, int entries_per_batch) {
+        if (db_state == FRESH) {
+            Open(write_sync);
+        }
+        atomkv::WriteBatch batch;
+        for (int i = 0; i < num_entries; i += entries_per_batch) {
+            auto tx = db_->Update();
+            auto bucket = tx.UserBucket();
+            for (int j = 0; j < entries_per_batch; j++) {
+                batch.Put(key[i+j].data(), key[i+j].size(), value[i+j].data(), value[i+j].size());
+                bytes_ += key[i+j].size() + value[i+j].size();
+                FinishedSingleOp();
+            }
+            bucket.Write(batch);
+            batch.Clear();
+            tx.Commit();
+        }
+    }
+
     void Read(Order order, const std::vector<std::string>& key, const std::vector<std::string>& value, int num_entries, int entries_per_batch) {
         for (int i = 0; i < num_entries; i += entries_per_batch) {
             auto tx = db_->View();
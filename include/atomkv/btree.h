@@ -12,7 +12,10 @@
 #include <span>
 #include <algorithm>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <string>
+#include <vector>
 
 #include <atomkv/noncopyable.h>
 #include <atomkv/page_format.h>
@@ -30,6 +33,22 @@ class BTree : noncopyable {
 public:
     using Iterator = BTreeIterator;
 
+    // A put or delete of a batch
+    struct BatchWrite {
+        std::span<const uint8_t> key;
+        std::span<const uint8_t> value;
+        bool is_delete;
+    };
+
+    // How a full node is divided
+    enum class SplitPolicy {
+        kHalf,
+        // Inserting past the right edge of the tree, the left node stays full
+        kAppend,
+        // Inserting before the left edge of the tree, the right node takes all the records
+        kPrepend,
+    };
+
 public:
     BTree(BucketImpl* bucket, PageId* root_pgid, Comparator comparator);
     ~BTree();
@@ -37,6 +56,12 @@ public:
     // Check if the tree is empty
     bool Empty() const;
 
+    // Check if the root page was written by a transaction after txid
+    // A page that is reused gets the txid of the new writer, so the same root page id alone is not enough
+    bool RootModifiedAfter(TxId txid);
+    // Same for the root of a sub bucket stored in this tree
+    bool ModifiedAfter(PageId pgid, TxId txid);
+
     // Search for the first element less than or equal to the specified key
     // Returns an iterator pointing to the element
     Iterator LowerBound(std::span<const uint8_t> key);
@@ -45,25 +70,55 @@ public:
     // Returns an iterator pointing to the element
     Iterator Get(std::span<const uint8_t> key);
 
+    // Search for the values of the keys, values[i] is set for keys[i] if it exists and is not a bucket
+    // The keys are searched in order, keys landing in the same subtree share its descent
+    void MultiGet(std::span<const std::span<const uint8_t>> keys, std::span<std::optional<std::span<const uint8_t>>> values);
+
     // Insert a record, allowing duplicate keys
     void Insert(std::span<const uint8_t> key, std::span<const uint8_t> value, bool is_bucket);
 
     // Insert a record, overwriting the value for duplicate keys
     void Put(std::span<const uint8_t> key, std::span<const uint8_t> value, bool is_bucket);
+    // Searches from the path of the hint when the key falls in its leaf
+    void Put(const Iterator& hint, std::span<const uint8_t> key, std::span<const uint8_t> value, bool is_bucket);
+
+    // Apply the writes sorted by key, the writes landing in the same leaf share the path searched and copied once
+    void Write(std::span<const BatchWrite> writes);
+
+    // Bulk load, build the tree bottom-up from records sorted by key, the tree must be empty
+    // Nodes are filled up to the fill factor and the pages are allocated in contiguous runs
+    void BeginLoad(double fill_factor);
+    void Load(std::span<const uint8_t> key, std::span<const uint8_t> value);
+    void FinishLoad();
+    bool loading() const { return load_ != nullptr; }
 
     // Directly update the value of the element pointed to by the specified iterator
     void Update(Iterator* iter, std::span<const uint8_t> value);
 
     // Delete the specified element
     bool Delete(std::span<const uint8_t> key);
+    bool Delete(const Iterator& hint, std::span<const uint8_t> key);
     void Delete(Iterator* iter);
 
+    // Delete the elements in [begin, end), the subtrees between the boundary paths are freed whole
+    // Sub buckets in the range are freed with their trees
+    void DeleteRange(std::span<const uint8_t> begin, std::span<const uint8_t> end);
+
     // Iterator functions
     Iterator begin() noexcept;
     Iterator end() noexcept;
 
     auto& bucket() const { return *bucket_; }
     auto& comparator() const { return comparator_.ptr_; }
+    auto& lower_bound_func() const { return lower_bound_func_; }
+    // Nodes keep key prefixes
+    auto& key_prefix() const { return key_prefix_; }
+    // The comparator follows the byte order of the keys
+    auto& byte_order() const { return byte_order_; }
+    // The key prefixes can narrow searches, they only follow the byte order
+    auto& prefix_search() const { return prefix_search_; }
+    // Nodes store their common key prefix once
+    auto& prefix_compression() const { return prefix_compression_; }
 
 private:
     // Get the sibling node
@@ -75,23 +130,58 @@ private:
     // Delete from branch nodes
     void Delete(Iterator* iter, BranchNode&& node, SlotId left_del_slot_id);
 
+    // Borrow from or merge with a sibling if the branch node is underfilled, the iterator points to its parent
+    void Rebalance(Iterator* iter, BranchNode&& node);
+
     // Merge leaf nodes
     void Merge(LeafNode&& left, LeafNode&& right);
 
+    // Borrow from or merge with a sibling if the leaf node at the front of the iterator is underfilled
+    void Rebalance(Iterator* iter, LeafNode&& node);
+
+    // Delete the elements in [begin, end) from the subtree, a null bound is unbounded
+    // Returns the page id of the subtree, which changes if the root of it is copied
+    PageId DeleteRange(PageId pgid, const std::span<const uint8_t>* begin, const std::span<const uint8_t>* end);
+
+    // Free all pages of the subtree, including overflow pages and the trees of sub buckets
+    void FreeTree(PageId pgid);
+
+    // Find the highest node without keys on the path to the key, besides the root
+    // The path leads to a leaf, returns the number of nodes on it below the found one, nullopt if there is none
+    std::optional<size_t> FindEmptyNode(Iterator* iter, std::span<const uint8_t> key);
+
+    // Choose how to split the front node of the iterator for an insertion at the slot
+    // Sequential loads along either edge of the tree leave the nodes full
+    SplitPolicy GetSplitPolicy(const Iterator& iter, Node& node, SlotId insert_slot_id) const;
+
     // Split a branch node
     // Returns the last element from the left node to move up and the new right node
-    std::tuple<std::span<const uint8_t>, BranchNode> Split(BranchNode* left, SlotId insert_pos, std::span<const uint8_t> key, PageId insert_right_child);
+    std::tuple<std::span<const uint8_t>, BranchNode> Split(BranchNode* left, SlotId insert_pos, std::span<const uint8_t> key, PageId insert_right_child, SplitPolicy policy);
 
     // Insert into a branch node
     void Put(Iterator* iter, Node&& left, Node&& right, std::span<const uint8_t> key);
 
+    // Get the shortest key that separates two adjacent leaf nodes, left_max < separator <= right_min
+    // Returns a prefix of right_min, only byte ordered keys of variable length can be truncated
+    std::span<const uint8_t> SeparatorKey(std::span<const uint8_t> left_max, std::span<const uint8_t> right_min) const;
+
     // Split a leaf node
     // Returns the new right node
-    LeafNode Split(LeafNode* left, SlotId insert_slot_id, std::span<const uint8_t> key, std::span<const uint8_t> value, bool is_bucket);
+    LeafNode Split(LeafNode* left, SlotId insert_slot_id, std::span<const uint8_t> key, std::span<const uint8_t> value, bool is_bucket, SplitPolicy policy);
 
     // Insert into a leaf node
     void Put(Iterator* iter, std::span<const uint8_t> key, std::span<const uint8_t> value, bool insert_only, bool is_bucket);
 
+    // Search for the sorted keys in the subtree, order holds their indexes in keys
+    void MultiGet(PageId pgid, std::span<const size_t> order, std::span<const std::span<const uint8_t>> keys, std::span<std::optional<std::span<const uint8_t>>> values);
+
+    // Take the next page of the run allocated for the bulk load
+    PageId AllocLoadPage();
+
+    // Insert past the last key directly into the cached rightmost leaf, without descending or copying the path
+    // Returns false if the cache cannot take the key
+    bool PutRightmost(std::span<const uint8_t> key, std::span<const uint8_t> value, bool is_bucket);
+
 private:
     friend class BTreeIterator;
 
@@ -99,6 +189,27 @@ private:
     PageId& root_pgid_;
 
     const Comparator comparator_;
+    const Node::LowerBoundFunc lower_bound_func_;
+    const bool key_prefix_;
+    const bool byte_order_;
+    const bool prefix_search_;
+    const bool prefix_compression_;
+
+    // The rightmost leaf written by this transaction, reset when deletions may restructure the tree
+    PageId rightmost_pgid_ = kPageInvalidId;
+
+    struct LoadState {
+        double fill_factor;
+        std::optional<LeafNode> leaf;
+        // The last key of the previous leaf
+        std::vector<uint8_t> last_key;
+        // The separators and page ids of the leaves, the separator of the first one is unused
+        std::vector<std::pair<std::vector<uint8_t>, PageId>> children;
+        // Pages left in the allocated run
+        PageId next_pgid = kPageInvalidId;
+        PageCount free_count = 0;
+    };
+    std::unique_ptr<LoadState> load_;
 };
 
 } // namespace atomkv
@@ -12,6 +12,7 @@
 #include <string>
 #include <optional>
 #include <variant>
+#include <vector>
 
 #include <atomkv/page_format.h>
 #include <atomkv/node.h>
@@ -34,6 +35,11 @@ public:
 
     using Stack = detail::Stack<std::pair<PageId, SlotId>, 32>;
 
+    // Number of following leaves prefetched ahead of Next
+    static constexpr SlotId kPrefetchLeafCount = 8;
+    // Number of following leaves prefetched ahead of Next in a sequential scan
+    static constexpr SlotId kSequentialPrefetchLeafCount = 32;
+
     enum class Status {
         kInvalid,
         kEq,
@@ -77,6 +83,14 @@ public:
     bool is_bucket() const;
     Status status() const { return status_; }
 
+    // Hints that the iterator is used for a long scan, so that Next prefetches further ahead.
+    // Only this iterator is affected, copies do not inherit it.
+    void set_sequential(bool sequential) { sequential_ = sequential; }
+    bool sequential() const { return sequential_; }
+    // The parent of the leaves prefetched ahead of Next, and the last of its slots prefetched
+    PageId prefetch_pgid() const { return prefetch_pgid_; }
+    SlotId prefetch_slot_id() const { return prefetch_slot_id_; }
+
     void First(PageId pgid);
     void Last(PageId pgid);
     void Next();
@@ -92,10 +106,22 @@ public:
 
     void CopyAllPagesByPath();
 
+    // Whether the branch nodes above the front node all descend through their last/first child,
+    // i.e. the front node is on the right/left edge of the tree
+    bool IsRightmostPath() const;
+    bool IsLeftmostPath() const;
+
+    // Search for the key within the leaf at the end of the path, keeping the path above it
+    // Returns false if the path is no longer in the tree or the key may be outside the leaf
+    bool SeekInLeaf(std::span<const uint8_t> key);
+
+    auto& btree() const { return *btree_; }
+
 private:
     std::pair<LeafNode&, SlotId> GetLeafNode(bool dirty) const;
     std::span<const uint8_t> GetKey() const;
     std::span<const uint8_t> GetValue() const;
+    void PrefetchLeaves();
 
 private:
     BTree* btree_;
@@ -103,6 +129,13 @@ private:
     Status status_ = Status::kInvalid;
 
     mutable std::optional<Node> cached_node_;
+    // The key under prefix compression, so that it is not overwritten by other iterators on the node
+    mutable std::vector<uint8_t> key_buf_;
+    bool sequential_ = false;
+
+    // Slots of the leaf's parent up to prefetch_slot_id_ have been prefetched
+    PageId prefetch_pgid_ = kPageInvalidId;
+    SlotId prefetch_slot_id_ = 0;
 };
 
 } // namespace atomkv
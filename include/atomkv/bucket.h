@@ -9,8 +9,15 @@
 
 #pragma once
 
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
 #include <atomkv/noncopyable.h>
 #include <atomkv/bucket_iterator.h>
+#include <atomkv/bulk_loader.h>
+#include <atomkv/write_batch.h>
 
 namespace atomkv {
 
@@ -27,6 +34,10 @@ public:
     ViewBucket SubViewBucket(std::string_view key);
     Iterator Get(const void* key_buf, size_t key_size) const;
     Iterator Get(std::string_view key) const;
+    // Get the values of several keys at once, faster than calling Get for each of them
+    // A key that does not exist or refers to a sub bucket gets nullopt
+    // Like the values of iterators, they point into the database and are invalidated by writes
+    std::vector<std::optional<std::string_view>> MultiGet(std::span<const std::string_view> keys) const;
     Iterator LowerBound(const void* key_buf, size_t key_size) const;
     Iterator LowerBound(std::string_view key) const;
 
@@ -53,6 +64,25 @@ public:
     void Put(std::string_view key, std::string_view value);
     bool Delete(const void* key_buf, size_t key_size);
     bool Delete(std::string_view key);
+
+    // Delete the keys in [begin, end), sub buckets in the range are deleted with their contents
+    // Whole subtrees inside the range are freed at once, the cost follows the pages freed rather than the keys
+    void DeleteRange(const void* begin_buf, size_t begin_size, const void* end_buf, size_t end_size);
+    void DeleteRange(std::string_view begin, std::string_view end);
+
+    // Put/Delete a key near the position of the hint, e.g. an iterator that was just read from
+    // The search starts from the leaf of the hint if the key falls in it, otherwise from the root
+    void Put(const Iterator& hint, const void* key_buf, size_t key_size, const void* value_buf, size_t value_size);
+    void Put(const Iterator& hint, std::string_view key, std::string_view value);
+    bool Delete(const Iterator& hint, const void* key_buf, size_t key_size);
+    bool Delete(const Iterator& hint, std::string_view key);
+
+    // Apply the puts and deletes of the batch
+    void Write(const WriteBatch& batch);
+
+    // Load sorted records into the bucket, which must be empty
+    // Leaves are filled up to the fill factor, lower factors leave room for later inserts
+    BulkLoader BulkLoad(double fill_factor = 1.0);
 };
 
 } // namespace atomkv
\ No newline at end of file
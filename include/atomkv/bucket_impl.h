@@ -11,13 +11,16 @@
 
 #include <optional>
 #include <map>
+#include <vector>
 
 #include <atomkv/btree.h>
 #include <atomkv/bucket_iterator.h>
+#include <atomkv/write_batch.h>
 
 namespace atomkv {
 
 class TxImpl;
+class BulkLoader;
 
 class BucketImpl : noncopyable {
 public:
@@ -29,16 +32,29 @@ public:
 
     bool Empty() const;
     Iterator Get(const void* key_buf, size_t key_size);
+    std::vector<std::optional<std::string_view>> MultiGet(std::span<const std::string_view> keys);
     Iterator LowerBound(const void* key_buf, size_t key_size);
     void Put(const void* key_buf, size_t key_size, const void* value_buf, size_t value_size, bool is_bucket);
+    void Put(const Iterator& hint, const void* key_buf, size_t key_size, const void* value_buf, size_t value_size, bool is_bucket);
     void Update(Iterator* iter, const void* value_buf, size_t value_size);
     bool Delete(const void* key_buf, size_t key_size);
+    bool Delete(const Iterator& hint, const void* key_buf, size_t key_size);
     void Delete(Iterator* iter);
+    void DeleteRange(const void* begin_buf, size_t begin_size, const void* end_buf, size_t end_size);
+    void Write(const WriteBatch& batch);
+    // Apply the writes encoded in a batch log
+    void Write(std::span<const uint8_t> batch);
+
+    void BeginBulkLoad(double fill_factor);
+    void BulkLoad(const void* key_buf, size_t key_size, const void* value_buf, size_t value_size);
+    void FinishBulkLoad();
 
     BucketImpl& SubBucket(std::string_view key, bool writable);
     BucketImpl& SubBucket(Iterator* iter, bool writable);
     bool DeleteSubBucket(std::string_view key);
     void DeleteSubBucket(Iterator* iter);
+    // Reload the roots of the opened sub buckets after the read transaction was renewed from old_txid
+    void RenewSubBuckets(TxId old_txid);
 
     Iterator begin() noexcept;
     Iterator end() noexcept;
@@ -53,13 +69,21 @@ public:
     bool has_sub_bucket_map() const { return sub_bucket_map_.has_value(); }
     auto& sub_bucket_map() const { assert(sub_bucket_map_.has_value()); return *sub_bucket_map_; }
     auto& sub_bucket_map() { assert(sub_bucket_map_.has_value()); return *sub_bucket_map_; }
+    void set_loader(BulkLoader* loader) { loader_ = loader; }
 
 protected:
+    // Reads and writes are refused until the bulk load is finished
+    void ThrowIfLoading() const;
+
     TxImpl* const tx_;
     BucketId bucket_id_;
     const bool writable_;
     BTree btree_;
     std::optional<std::map<std::string, std::pair<BucketId, PageId>>> sub_bucket_map_;
+    // The loaded records waiting to be logged as a batch
+    WriteBatch load_batch_;
+    // Detached when the bucket is destroyed with its transaction
+    BulkLoader* loader_{ nullptr };
 };
 
 } // namespace atomkv
\ No newline at end of file
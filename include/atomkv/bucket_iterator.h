@@ -77,6 +77,8 @@ public:
         return iter_.value<ValueT>();
     }
 
+    // Points into the page and stays valid with the transaction,
+    // with prefix_compression it points into the iterator and is only valid until the iterator is moved or destroyed
     std::string_view key() const {
         return iter_.key();
     }
@@ -89,6 +91,11 @@ public:
         return iter_.is_bucket();
     }
 
+    // Hints that the iterator is used for a long scan, so that it reads further ahead, copies do not inherit it
+    void set_sequential(bool sequential) {
+        iter_.set_sequential(sequential);
+    }
+
 private:
     friend class BucketImpl;
 
@@ -0,0 +1,44 @@
+//The MIT License(MIT)
+//Copyright © 2024 https://github.com/yuyuaqwq
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files(the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and /or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#pragma once
+
+#include <string_view>
+
+#include <atomkv/noncopyable.h>
+
+namespace atomkv {
+
+class BucketImpl;
+
+// Loads records sorted by key into an empty bucket, building the tree from the bottom up
+// Other reads and writes of the bucket throw until the load is finished,
+// a load that is still open when the transaction commits is finished by the commit.
+// The loader is detached when its transaction ends, it can no longer be used after that.
+class BulkLoader : noncopyable {
+public:
+    BulkLoader(BulkLoader&& right) noexcept;
+    // Does not finish the load, that is left to Finish or to the commit which can report errors
+    ~BulkLoader();
+
+    // The keys must be strictly increasing
+    void Add(const void* key_buf, size_t key_size, const void* value_buf, size_t value_size);
+    void Add(std::string_view key, std::string_view value);
+    void Finish();
+
+private:
+    friend class UpdateBucket;
+    friend class BucketImpl;
+
+    explicit BulkLoader(BucketImpl* bucket);
+
+private:
+    BucketImpl* bucket_;
+};
+
+} // namespace atomkv
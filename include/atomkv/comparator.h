@@ -36,6 +36,27 @@ inline std::strong_ordering UInt64CompFunc(std::span<const uint8_t> key1, std::s
     return key1_ <=> key2_;
 }
 
+// Big-endian integers order the same as their bytes, so nodes can search them with key prefixes
+inline std::strong_ordering UInt32BigEndianCompFunc(std::span<const uint8_t> key1, std::span<const uint8_t> key2) {
+    assert(key1.size() == sizeof(uint32_t) && key2.size() == sizeof(uint32_t));
+    uint32_t key1_ = 0, key2_ = 0;
+    for (size_t i = 0; i < sizeof(uint32_t); ++i) {
+        key1_ = key1_ << 8 | key1[i];
+        key2_ = key2_ << 8 | key2[i];
+    }
+    return key1_ <=> key2_;
+}
+
+inline std::strong_ordering UInt64BigEndianCompFunc(std::span<const uint8_t> key1, std::span<const uint8_t> key2) {
+    assert(key1.size() == sizeof(uint64_t) && key2.size() == sizeof(uint64_t));
+    uint64_t key1_ = 0, key2_ = 0;
+    for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+        key1_ = key1_ << 8 | key1[i];
+        key2_ = key2_ << 8 | key2[i];
+    }
+    return key1_ <=> key2_;
+}
+
 inline std::strong_ordering ByteArrayCompFunc(std::span<const uint8_t> key1, std::span<const uint8_t> key2) {
     int64_t res = std::memcmp(key1.data(), key2.data(), std::min(key1.size(), key2.size()));
     if (res == 0) {
@@ -53,7 +74,9 @@ inline std::strong_ordering ByteArrayCompFunc(std::span<const uint8_t> key1, std
 }
 
 constexpr Comparator UInt32Comparator{ UInt32CompFunc };
-constexpr Comparator UInt64Comparator{ UInt32CompFunc };
+constexpr Comparator UInt64Comparator{ UInt64CompFunc };
+constexpr Comparator UInt32BigEndianComparator{ UInt32BigEndianCompFunc };
+constexpr Comparator UInt64BigEndianComparator{ UInt64BigEndianCompFunc };
 constexpr Comparator ByteArrayComparator{ ByteArrayCompFunc };
 
 } // namespace atomkv
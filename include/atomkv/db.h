@@ -23,6 +23,8 @@ public:
     static std::unique_ptr<DB> Open(const Options& options, const std::string_view path);
     virtual UpdateTx Update() = 0;
     virtual ViewTx View() = 0;
+    // Write transaction that runs concurrently with others until its Commit, see OptimisticTx
+    virtual OptimisticTx OptimisticUpdate() = 0;
 };
 
 } // namespace atomkv
\ No newline at end of file
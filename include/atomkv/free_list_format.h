@@ -0,0 +1,33 @@
+//The MIT License(MIT)
+//Copyright © 2024 https://github.com/yuyuaqwq
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files(the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and /or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <atomkv/page_format.h>
+
+namespace atomkv {
+
+#pragma pack(push, 1)
+// Changes to the free list since it was last rewritten are saved as a chain of
+// delta blocks, the newest one referenced by the meta.
+struct FreeListDeltaHeader {
+    PageId prev_pgid;       // the previous (older) delta block.
+    PageCount page_count;   // count of pages occupied by this block.
+    uint32_t record_count;
+};
+
+struct FreeListDeltaRecord {
+    PageId pgid;
+    PageCount count;        // kFreeListDeltaRemoved is set if the extent is no longer free.
+};
+#pragma pack(pop)
+
+constexpr PageCount kFreeListDeltaRemoved = kPageMaxCount;
+
+} // namespace atomkv
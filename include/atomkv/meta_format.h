@@ -17,16 +17,26 @@
 
 namespace atomkv {
 
+// The flags change the node format, they are part of the layout of version 2
+// Nodes keep a key prefix array, see Node::KeyPrefix
+constexpr uint32_t kMetaFlagKeyPrefix = 1 << 0;
+// Nodes store the prefix shared by their keys once, see Node::GetNodePrefix
+constexpr uint32_t kMetaFlagPrefixCompression = 1 << 1;
+constexpr uint32_t kMetaFlagMask = kMetaFlagKeyPrefix | kMetaFlagPrefixCompression;
+
 #pragma pack(push, 1)
 struct MetaStruct {
     uint32_t sign;
     PageSize page_size;
     uint32_t min_version;
+    uint32_t flags;
     PageCount page_count;
     PageId user_root;
     PageId free_list_pgid;
     uint32_t free_pair_count;
     PageCount free_list_page_count;
+    PageId free_delta_pgid;
+    uint32_t free_delta_count;
     TxId txid;
     uint32_t crc32;
 };
@@ -34,11 +44,34 @@ struct MetaStruct {
 
 constexpr size_t kMetaSize = sizeof(MetaStruct);
 
+// The layout above is read from version 2 on, earlier versions must refuse the file
+constexpr uint32_t kMetaMinVersion = 2;
+
+// The layout of files written by version 1, they are converted when opened
+#pragma pack(push, 1)
+struct MetaStructV1 {
+    uint32_t sign;
+    PageSize page_size;
+    uint32_t min_version;
+    PageCount page_count;
+    PageId user_root;
+    PageId free_list_pgid;
+    uint32_t free_pair_count;
+    PageCount free_list_page_count;
+    TxId txid;
+    uint32_t crc32;
+};
+#pragma pack(pop)
+
+constexpr size_t kMetaV1Size = sizeof(MetaStructV1);
+
 inline void CopyMetaInfo(MetaStruct* dst, const MetaStruct& src) {
     dst->user_root = src.user_root;
     dst->free_list_pgid = src.free_list_pgid;
     dst->free_pair_count = src.free_pair_count;
     dst->free_list_page_count = src.free_list_page_count;
+    dst->free_delta_pgid = src.free_delta_pgid;
+    dst->free_delta_count = src.free_delta_count;
     dst->page_count = src.page_count;
     dst->txid = src.txid;
 }
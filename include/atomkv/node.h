@@ -20,6 +20,7 @@
 #include <atomkv/noncopyable.h>
 #include <atomkv/node_format.h>
 #include <atomkv/page.h>
+#include <atomkv/comparator.h>
 
 namespace atomkv {
 
@@ -39,10 +40,35 @@ public:
     bool IsBranch() const;
 
     std::span<const uint8_t> GetKey(SlotId slot_id);
+    // Materializes the key in key_buf under prefix compression,
+    // the buffer is left untouched if it already holds the key
+    std::span<const uint8_t> GetKey(SlotId slot_id, std::vector<uint8_t>* key_buf);
     std::pair<SlotId, bool> LowerBound(std::span<const uint8_t> key);
+    template <class Compare>
+    std::pair<SlotId, bool> LowerBound(std::span<const uint8_t> key, Compare compare);
+
+    // LowerBound specialized for a comparator, selected once per tree.
+    // Built-in comparators are inlined, custom ones are called through the pointer.
+    using LowerBoundFunc = std::pair<SlotId, bool>(*)(Node* node, std::span<const uint8_t> key);
+    static LowerBoundFunc SelectLowerBound(Comparator comparator);
+
+    // The first bytes of a key in big-endian, so prefixes compare in the byte order of the keys
+    using KeyPrefix = uint32_t;
+    static KeyPrefix MakeKeyPrefix(std::span<const uint8_t> key);
+    KeyPrefix GetKeyPrefix(SlotId slot_id);
+
+    // Reverses the order of the slots
+    void ReverseSlots();
+
+    // The prefix shared by all keys of the node, empty without prefix compression.
+    // An empty node takes it from the first key inserted, it narrows as other keys are inserted.
+    std::span<const uint8_t> GetNodePrefix();
 
     double GetFillRate();
 
+    // Free the overflow pages of the records without modifying the node, for a node being freed whole
+    void FreeOverflowPages();
+
     Node Copy() const;
     Node AddReference() const;
     Page Release();
@@ -57,7 +83,27 @@ public:
 protected:
     PageSize MaxInlineRecordSize();
 
-    bool RequestSpaceFor(std::span<const uint8_t> key, std::span<const uint8_t> value, bool slot_needed);
+    // With key prefixes, the prefix array follows the slots: slots[count] | prefixes[count]
+    PageSize SlotSize() const;
+    uint8_t* KeyPrefixPtr();
+    void SetKeyPrefix(SlotId slot_id, KeyPrefix prefix);
+    // Finds the slots whose key prefix equals the prefix
+    std::pair<SlotId, SlotId> KeyPrefixEqualRange(KeyPrefix prefix);
+    // Opens or closes the slot at slot_id, moving the prefix array along
+    void InsertSlot(SlotId slot_id);
+    void EraseSlot(SlotId slot_id);
+
+    PageSize TrailerSize();
+    void InitTrailer();
+    // The key without the node prefix, as compared by byte order searches
+    std::span<const uint8_t> GetKeySuffix(SlotId slot_id);
+    // Only for an empty node
+    void SetNodePrefix(std::span<const uint8_t> prefix);
+    // Narrows the node prefix, the removed bytes are moved into the records
+    void NarrowNodePrefix(size_t prefix_size, SlotId replaced_slot_id);
+
+    // replaced_slot_id is the slot whose record is deleted for an update
+    bool RequestSpaceFor(std::span<const uint8_t> key, std::span<const uint8_t> value, bool slot_needed, SlotId replaced_slot_id = kSlotInvalidId);
     size_t SpaceNeeded(size_t record_size, bool slot_needed);
     // 包括节点头的大小
     PageSize SlotSpace();
@@ -82,6 +128,9 @@ protected:
 
     std::optional<Page> page_;
     NodeData* data_;
+
+    // Full keys materialized by GetKey under prefix compression
+    std::vector<uint8_t> key_buf_;
 };
 
 class BranchNode : public Node {
@@ -22,6 +22,11 @@ enum class NodeType : uint16_t {
     kLeaf,
 };
 
+// With prefix compression, the end of the page holds the prefix shared by the keys of the node:
+// records | prefix | NodePrefixSize
+using NodePrefixSize = uint16_t;
+constexpr size_t kNodePrefixMaxSize = 128;
+
 struct OverflowRecord {
     PageId pgid;
 };
@@ -19,6 +19,12 @@ enum class DbMode {
     kWal,
 };
 
+enum class MmapAdvice {
+    kNormal,
+    // Disables readahead, for point lookups on data larger than memory
+    kRandom,
+};
+
 struct Options {
     PageSize page_size = 0;
     const Comparator comparator = ByteArrayComparator;
@@ -29,6 +35,36 @@ struct Options {
 
     // kWal
     const size_t max_wal_size = 1024 * 1024 * 64;
+
+    // Geometry, sizes are in bytes and must be multiples of the page size.
+    // Reserves the address space of the mapping up front, the file can then grow
+    // up to this size without being remapped. 0 maps only the current file size.
+    const size_t map_size = 0;
+    // Size of a newly created file.
+    const size_t initial_size = 0;
+    // The file grows by this step, 0 doubles it up to 1GB and then grows it by 1GB.
+    const size_t growth_step = 0;
+    // The file never grows beyond this size, 0 for no limit other than map_size.
+    const size_t max_size = 0;
+    // Free pages at the end of the file are truncated on commit once they exceed this size, 0 to disable.
+    const size_t shrink_threshold = 0;
+
+    // Data mapping
+    const MmapAdvice mmap_advice = MmapAdvice::kNormal;
+    // Asks for transparent huge pages to reduce TLB misses, ignored where unsupported.
+    // A file on hugetlbfs is mapped with huge pages without this.
+    const bool huge_pages = false;
+
+    // Node format, only used when the file is created.
+    // Keeps the first bytes of every key in a packed array next to the slots,
+    // so searches with ByteArrayComparator mostly skip the records.
+    const bool key_prefix = false;
+    // Stores the prefix shared by the keys of a node once, and only the suffixes in the records.
+    // Keys are then assembled by the iterator, see BucketIterator::key.
+    const bool prefix_compression = false;
+
+    // Read transactions that can be open at the same time, each takes a cache line in the shm file.
+    const uint32_t max_readers = 128;
 };
 
 } // namespace atomkv
\ No newline at end of file
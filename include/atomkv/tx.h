@@ -10,6 +10,10 @@
 #pragma once
 
 #include <vector>
+#include <map>
+#include <string>
+#include <future>
+#include <optional>
 #include <shared_mutex>
 
 #include <atomkv/noncopyable.h>
@@ -24,13 +28,21 @@ class TxImpl;
 
 class ViewTx : noncopyable {
 public:
-    ViewTx(TxManager* tx_manager, const MetaStruct& meta, std::shared_mutex* mmap_mutex);
+    ViewTx(TxManager* tx_manager, const MetaStruct& meta, std::shared_mutex* mmap_mutex, uint32_t reader_slot);
     ~ViewTx();
 
     ViewBucket UserBucket();
 
+    // Release the snapshot so writers can reuse its pages, the transaction is parked until Renew
+    // The buckets and iterators obtained from it must not be used in the meantime
+    void Reset();
+    // Move to the latest committed version, can also be called without Reset
+    // Opened buckets stay valid and see the new version, iterators are invalidated
+    void Renew();
+
 private:
     friend class TxManager;
+    friend class OptimisticTx;
 
     std::shared_lock<std::shared_mutex> mmap_lock_;
     // TxImpl* tx_;    // Can use stack object.
@@ -47,9 +59,51 @@ public:
     UpdateBucket UserBucket();
     void RollBack();
     void Commit();
+    // Commit without waiting for the sync, the next write transaction can start meanwhile
+    // In kUpdateInPlace the version is visible to readers before it is durable,
+    // the future becomes ready once it is, or holds the error of the sync.
+    // After a failed sync the database refuses write transactions, including one already running.
+    std::future<void> CommitAsync();
 
 private:
+    friend class OptimisticTx;
+
     TxImpl* tx_;
 };
 
+// A write transaction that only takes the update lock in Commit
+// Reads come from a snapshot and writes are buffered per sub bucket of the user bucket.
+// Commit fails if a sub bucket it read or wrote was modified after the snapshot,
+// so transactions on disjoint sub buckets never conflict.
+// Only reading and buffering run concurrently, the validation, the writes to the tree
+// and the commit are serialized with other writers under the update lock.
+class OptimisticTx : noncopyable {
+public:
+    explicit OptimisticTx(TxManager* tx_manager);
+    ~OptimisticTx();
+
+    // The sub bucket in the snapshot, the buffered writes are not visible through it
+    ViewBucket SubViewBucket(std::string_view key);
+    // The writes to the sub bucket, it is created on commit if it does not exist
+    WriteBatch& SubWriteBatch(std::string_view key);
+
+    // Returns false and writes nothing if a conflict is found
+    bool Commit();
+
+private:
+    struct BucketAccess {
+        // The root in the snapshot
+        PageId root_pgid;
+        std::optional<WriteBatch> batch;
+    };
+
+    BucketAccess& Access(std::string_view key);
+
+private:
+    TxManager* const tx_manager_;
+    ViewTx view_tx_;
+    std::map<std::string, BucketAccess, std::less<>> buckets_;
+    bool committed_ = false;
+};
+
 } // namespace atomkv
\ No newline at end of file
@@ -12,6 +12,7 @@
 #include <cstdint>
 
 #include <array>
+#include <future>
 #include <memory>
 #include <string_view>
 
@@ -24,6 +25,8 @@ namespace atomkv {
 
 class TxManager;
 
+constexpr uint32_t kInvalidReaderSlot = 0xffffffff;
+
 class TxImpl : noncopyable {
 public:
     TxImpl(TxManager* tx_manager, const MetaStruct& meta, bool writable);
@@ -35,6 +38,12 @@ public:
 
     void RollBack();
     void Commit();
+    std::future<void> CommitAsync();
+
+    // Read transaction, stop holding back the pages of the snapshot
+    void Reset();
+    // Read transaction, move to the latest snapshot
+    void Renew();
 
     // Specifies whether the page needs to be copied.
     bool CopyNeeded(TxId txid) const;
@@ -42,6 +51,8 @@ public:
     void AppendSubBucketLog(BucketId bucket_id, std::span<const uint8_t> key);
     void AppendPutLog(BucketId bucket_id, std::span<const uint8_t> key, std::span<const uint8_t> value, bool is_bucket);
     void AppendDeleteLog(BucketId bucket_id, std::span<const uint8_t> key);
+    void AppendBatchLog(BucketId bucket_id, std::span<const uint8_t> batch);
+    void AppendDeleteRangeLog(BucketId bucket_id, std::span<const uint8_t> begin, std::span<const uint8_t> end);
 
     auto& user_bucket() { return user_bucket_; }
     auto& user_bucket() const { return user_bucket_; }
@@ -53,6 +64,13 @@ public:
     auto& meta_struct() { return meta_format_; }
     auto& sub_bucket_cache() const { return sub_bucket_cache_; }
     auto& sub_bucket_cache() { return sub_bucket_cache_; }
+    void set_reader_slot(uint32_t reader_slot) { reader_slot_ = reader_slot; }
+
+protected:
+    // Link the trees of the loads that were not finished
+    void FinishBulkLoads();
+    // Store the roots of the opened sub buckets into their parents
+    void SaveSubBucketRoots();
 
 protected:
     TxManager* const tx_manager_;
@@ -61,6 +79,9 @@ protected:
     const bool writable_;
     BucketImpl user_bucket_;
     std::vector<std::unique_ptr<BucketImpl>> sub_bucket_cache_;
+
+    // The shm slot publishing the snapshot of a read transaction
+    uint32_t reader_slot_ = kInvalidReaderSlot;
 };
 
 } // namespace atomkv
\ No newline at end of file
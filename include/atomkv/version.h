@@ -10,5 +10,5 @@
 #pragma once
 
 #define ATOMKV_SIGN 'atom'
-#define ATOMKV_VERSION 1
-#define ATOMKV_VERSION_STR "0.0.1"
\ No newline at end of file
+#define ATOMKV_VERSION 2
+#define ATOMKV_VERSION_STR "0.0.2"
\ No newline at end of file
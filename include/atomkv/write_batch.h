@@ -0,0 +1,41 @@
+//The MIT License(MIT)
+//Copyright © 2024 https://github.com/yuyuaqwq
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files(the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and /or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace atomkv {
+
+// Puts and deletes applied to a bucket together
+// The writes are sorted by key and applied leaf by leaf, the last write of a key wins
+class WriteBatch {
+public:
+    WriteBatch();
+    ~WriteBatch();
+
+    void Put(const void* key_buf, size_t key_size, const void* value_buf, size_t value_size);
+    void Put(std::string_view key, std::string_view value);
+    void Delete(const void* key_buf, size_t key_size);
+    void Delete(std::string_view key);
+    void Clear();
+
+    size_t count() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+private:
+    friend class BucketImpl;
+
+    // The writes in the format of the batch log:
+    // type | key size | key [| value size | value]
+    std::string rep_;
+    size_t count_ = 0;
+};
+
+} // namespace atomkv
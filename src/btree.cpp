@@ -13,13 +13,21 @@
 #include <atomkv/tx_impl.h>
 
 #include "pager.h"
+#include "db_impl.h"
 
 namespace atomkv {
 
 BTree::BTree(BucketImpl* bucket, PageId* root_pgid, Comparator comparator)
     : bucket_(bucket)
     , root_pgid_(*root_pgid)
-    , comparator_(comparator) {}
+    , comparator_(comparator)
+    , lower_bound_func_(Node::SelectLowerBound(comparator))
+    , key_prefix_(bucket->pager().db().meta().meta_struct().flags & kMetaFlagKeyPrefix)
+    , byte_order_(comparator.ptr_ == ByteArrayCompFunc
+        || comparator.ptr_ == UInt32BigEndianCompFunc
+        || comparator.ptr_ == UInt64BigEndianCompFunc)
+    , prefix_search_(key_prefix_ && byte_order_)
+    , prefix_compression_(bucket->pager().db().meta().meta_struct().flags & kMetaFlagPrefixCompression) {}
 
 BTree::~BTree() = default;
 
@@ -27,6 +35,17 @@ bool BTree::Empty() const {
     return root_pgid_ == kPageInvalidId;
 }
 
+bool BTree::RootModifiedAfter(TxId txid) {
+    return ModifiedAfter(root_pgid_, txid);
+}
+
+bool BTree::ModifiedAfter(PageId pgid, TxId txid) {
+    if (pgid == kPageInvalidId) {
+        return false;
+    }
+    return Node(this, pgid, false).last_modified_txid() > txid;
+}
+
 BTree::Iterator BTree::LowerBound(std::span<const uint8_t> key) {
     auto iter = Iterator(this);
     auto continue_ = iter.Top(key);
@@ -44,6 +63,80 @@ BTree::Iterator BTree::Get(std::span<const uint8_t> key) {
     return iter;
 }
 
+void BTree::MultiGet(std::span<const std::span<const uint8_t>> keys, std::span<std::optional<std::span<const uint8_t>>> values) {
+    assert(keys.size() == values.size());
+    std::fill(values.begin(), values.end(), std::nullopt);
+    if (Empty() || keys.empty()) {
+        return;
+    }
+    std::vector<size_t> order(keys.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return comparator_.ptr_(keys[a], keys[b]) < 0;
+    });
+    MultiGet(root_pgid_, order, keys, values);
+}
+
+void BTree::MultiGet(PageId pgid, std::span<const size_t> order, std::span<const std::span<const uint8_t>> keys, std::span<std::optional<std::span<const uint8_t>>> values) {
+    auto node = Node(this, pgid, false);
+    if (node.IsLeaf()) {
+        auto leaf = LeafNode(this, node.Release());
+        for (auto i : order) {
+            auto [slot_id, eq] = leaf.LowerBound(keys[i]);
+            if (eq && !leaf.IsBucket(slot_id)) {
+                values[i] = leaf.GetValue(slot_id);
+            }
+        }
+        return;
+    }
+
+    // Split the keys among the children, the keys following one take a single comparison
+    // against the separator bounding its child instead of a search of the node
+    auto branch = BranchNode(this, node.Release());
+    std::vector<std::pair<PageId, std::span<const size_t>>> groups;
+    size_t begin = 0;
+    while (begin < order.size()) {
+        auto [slot_id, eq] = branch.LowerBound(keys[order[begin]]);
+        if (eq) {
+            ++slot_id;
+        }
+        size_t end = begin + 1;
+        if (slot_id < branch.count()) {
+            auto separator = branch.GetKey(slot_id);
+            while (end < order.size() && comparator_.ptr_(keys[order[end]], separator) < 0) {
+                ++end;
+            }
+        } else {
+            end = order.size();
+        }
+        groups.push_back({ branch.GetLeftChild(slot_id), order.subspan(begin, end - begin) });
+        begin = end;
+    }
+
+    // Read in the children of the following groups while the first ones are searched
+    if (groups.size() > 1) {
+        auto& pager = bucket_->pager();
+        // Adjacent children are prefetched together
+        PageId run_pgid = groups[1].first;
+        PageCount run_count = 1;
+        for (size_t i = 2; i < groups.size(); ++i) {
+            if (groups[i].first == run_pgid + run_count) {
+                ++run_count;
+                continue;
+            }
+            pager.Prefetch(run_pgid, run_count);
+            run_pgid = groups[i].first;
+            run_count = 1;
+        }
+        pager.Prefetch(run_pgid, run_count);
+    }
+    for (auto& [child_pgid, child_order] : groups) {
+        MultiGet(child_pgid, child_order, keys, values);
+    }
+}
+
 void BTree::Insert(std::span<const uint8_t> key, std::span<const uint8_t> value, bool is_bucket) {
     auto iter = LowerBound(key);
     iter.CopyAllPagesByPath();
@@ -51,11 +144,144 @@ void BTree::Insert(std::span<const uint8_t> key, std::span<const uint8_t> value,
 }
 
 void BTree::Put(std::span<const uint8_t> key, std::span<const uint8_t> value, bool is_bucket) {
+    if (PutRightmost(key, value, is_bucket)) {
+        return;
+    }
     auto iter = LowerBound(key);
     iter.CopyAllPagesByPath();
     Put(&iter, key, value, false, is_bucket);
 }
 
+void BTree::Put(const Iterator& hint, std::span<const uint8_t> key, std::span<const uint8_t> value, bool is_bucket) {
+    auto iter = hint;
+    if (&hint.btree() != this || !iter.SeekInLeaf(key)) {
+        Put(key, value, is_bucket);
+        return;
+    }
+    iter.CopyAllPagesByPath();
+    Put(&iter, key, value, false, is_bucket);
+}
+
+void BTree::Write(std::span<const BatchWrite> writes) {
+    auto iter = Iterator(this);
+    for (auto& write : writes) {
+        // The insertions and deletions keep the path unless they split or merge the leaf.
+        // Only the first write to a leaf copies the path, the following ones stop at the copied leaf.
+        if (!iter.SeekInLeaf(write.key)) {
+            iter = LowerBound(write.key);
+        }
+        if (write.is_delete) {
+            if (iter.status() != Iterator::Status::kEq) {
+                continue;
+            }
+            iter.CopyAllPagesByPath();
+            Delete(&iter);
+        } else {
+            iter.CopyAllPagesByPath();
+            Put(&iter, write.key, write.value, false, false);
+        }
+    }
+}
+
+void BTree::BeginLoad(double fill_factor) {
+    if (!Empty() || load_) {
+        throw std::invalid_argument("Bulk load requires an empty bucket.");
+    }
+    if (!(fill_factor > 0 && fill_factor <= 1)) {
+        throw std::invalid_argument("The fill factor must be in (0, 1].");
+    }
+    load_ = std::make_unique<LoadState>();
+    load_->fill_factor = fill_factor;
+}
+
+void BTree::Load(std::span<const uint8_t> key, std::span<const uint8_t> value) {
+    assert(load_);
+    auto& state = *load_;
+    if (state.leaf.has_value()) {
+        auto& leaf = *state.leaf;
+        if (comparator_.ptr_(key, leaf.GetKey(leaf.count() - 1)) <= 0) {
+            throw std::invalid_argument("The keys of a bulk load must be strictly increasing.");
+        }
+        if (leaf.GetFillRate() < state.fill_factor && leaf.Append(key, value)) {
+            leaf.SetIsBucket(leaf.count() - 1, false);
+            return;
+        }
+        auto last_key = leaf.GetKey(leaf.count() - 1);
+        state.last_key.assign(last_key.begin(), last_key.end());
+    }
+
+    std::vector<uint8_t> separator;
+    if (state.leaf.has_value()) {
+        auto span = SeparatorKey(state.last_key, key);
+        separator.assign(span.begin(), span.end());
+    }
+    state.leaf.emplace(this, AllocLoadPage(), true);
+    auto& leaf = *state.leaf;
+    leaf.Build();
+    auto success = leaf.Append(key, value);
+    assert(success);
+    leaf.SetIsBucket(0, false);
+    state.children.push_back({ std::move(separator), leaf.page_id() });
+}
+
+void BTree::FinishLoad() {
+    assert(load_);
+    auto& state = *load_;
+    if (state.leaf.has_value()) {
+        rightmost_pgid_ = state.leaf->page_id();
+        state.leaf.reset();
+    }
+
+    // Build the branch levels from the bottom up
+    auto children = std::move(state.children);
+    while (children.size() > 1) {
+        decltype(children) parents;
+        size_t i = 0;
+        while (i < children.size()) {
+            auto node = BranchNode(this, AllocLoadPage(), true);
+            node.Build(children[i].second);
+            parents.push_back({ std::move(children[i].first), node.page_id() });
+            ++i;
+            while (i < children.size()) {
+                if (node.count() >= 2 && node.GetFillRate() >= state.fill_factor) {
+                    break;
+                }
+                if (!node.Append(children[i].first, children[i].second, true)) {
+                    break;
+                }
+                ++i;
+            }
+            if (i == children.size() - 1) {
+                // A branch node needs two children, the last node takes one from this node
+                assert(node.count() >= 2);
+                node.Pop(true);
+                --i;
+            }
+        }
+        children = std::move(parents);
+    }
+    if (!children.empty()) {
+        root_pgid_ = children[0].second;
+    }
+
+    if (state.free_count > 0) {
+        bucket_->pager().Free(state.next_pgid, state.free_count);
+    }
+    load_.reset();
+}
+
+PageId BTree::AllocLoadPage() {
+    // Allocating runs of pages keeps the tree in the order of the keys on disk
+    constexpr PageCount kLoadAllocCount = 64;
+    auto& state = *load_;
+    if (state.free_count == 0) {
+        state.next_pgid = bucket_->pager().Alloc(kLoadAllocCount);
+        state.free_count = kLoadAllocCount;
+    }
+    --state.free_count;
+    return state.next_pgid++;
+}
+
 void BTree::Update(Iterator* iter, std::span<const uint8_t> value) {
     auto [pgid, slot_id] = iter->Front();
     auto node = LeafNode(this, pgid, true);
@@ -64,6 +290,7 @@ void BTree::Update(Iterator* iter, std::span<const uint8_t> value) {
 }
 
 bool BTree::Delete(std::span<const uint8_t> key) {
+    rightmost_pgid_ = kPageInvalidId;
     auto iter = LowerBound(key);
     if (iter.status() != Iterator::Status::kEq) {
         return false;
@@ -73,6 +300,197 @@ bool BTree::Delete(std::span<const uint8_t> key) {
     return true;
 }
 
+bool BTree::Delete(const Iterator& hint, std::span<const uint8_t> key) {
+    auto iter = hint;
+    if (&hint.btree() != this || !iter.SeekInLeaf(key)) {
+        return Delete(key);
+    }
+    if (iter.status() != Iterator::Status::kEq) {
+        return false;
+    }
+    iter.CopyAllPagesByPath();
+    Delete(&iter);
+    return true;
+}
+
+void BTree::DeleteRange(std::span<const uint8_t> begin, std::span<const uint8_t> end) {
+    if (Empty() || comparator_.ptr_(begin, end) >= 0) {
+        return;
+    }
+    rightmost_pgid_ = kPageInvalidId;
+    root_pgid_ = DeleteRange(root_pgid_, &begin, &end);
+
+    // The cut may leave nodes without keys on the two boundary paths, which the searches for the bounds pass through
+    // Rebalance them from the top, so the parent of each one has a sibling to offer
+    while (true) {
+        auto root = Node(this, root_pgid_, false);
+        if (root.IsBranch() && root.count() == 0) {
+            auto old_root = root_pgid_;
+            root_pgid_ = BranchNode(this, root.Release()).GetTailChild();
+            bucket_->pager().Free(old_root, 1);
+            continue;
+        }
+
+        auto iter = Iterator(this);
+        auto below_count = FindEmptyNode(&iter, begin);
+        if (!below_count.has_value()) {
+            iter = Iterator(this);
+            below_count = FindEmptyNode(&iter, end);
+            if (!below_count.has_value()) {
+                break;
+            }
+        }
+        iter.CopyAllPagesByPath();
+        for (size_t i = 0; i < *below_count; ++i) {
+            iter.Pop();
+        }
+        auto node = Node(this, iter.Front().first, true);
+        if (node.IsLeaf()) {
+            Rebalance(&iter, LeafNode(this, node.Release()));
+        } else {
+            iter.Pop();
+            Rebalance(&iter, BranchNode(this, node.Release()));
+        }
+    }
+}
+
+PageId BTree::DeleteRange(PageId pgid, const std::span<const uint8_t>* begin, const std::span<const uint8_t>* end) {
+    auto& tx = bucket_->tx();
+    auto node = Node(this, pgid, true);
+    if (node.IsLeaf()) {
+        auto leaf = LeafNode(this, node.Release());
+        SlotId first = begin ? leaf.LowerBound(*begin).first : 0;
+        SlotId last = end ? leaf.LowerBound(*end).first : leaf.count();
+        if (first >= last) {
+            return pgid;
+        }
+        if (tx.CopyNeeded(leaf.last_modified_txid())) {
+            leaf = LeafNode(this, leaf.Copy().Release());
+        }
+        for (SlotId slot_id = last - 1; slot_id >= first; --slot_id) {
+            if (leaf.IsBucket(slot_id)) {
+                PageId sub_root_pgid;
+                std::memcpy(&sub_root_pgid, leaf.GetValue(slot_id).data(), sizeof(sub_root_pgid));
+                if (sub_root_pgid != kPageInvalidId) {
+                    FreeTree(sub_root_pgid);
+                }
+            }
+            leaf.Delete(slot_id);
+        }
+        return leaf.page_id();
+    }
+
+    auto branch = BranchNode(this, node.Release());
+    // The children holding the bounds, those between them only hold keys in the range
+    SlotId first = 0;
+    SlotId last = branch.count();
+    if (begin) {
+        auto [slot_id, eq] = branch.LowerBound(*begin);
+        first = eq ? slot_id + 1 : slot_id;
+    }
+    if (end) {
+        auto [slot_id, eq] = branch.LowerBound(*end);
+        last = eq ? slot_id + 1 : slot_id;
+    }
+    if (first == last) {
+        auto child = branch.GetLeftChild(first);
+        auto new_child = DeleteRange(child, begin, end);
+        if (new_child == child) {
+            return pgid;
+        }
+        if (tx.CopyNeeded(branch.last_modified_txid())) {
+            branch = BranchNode(this, branch.Copy().Release());
+        }
+        branch.SetLeftChild(first, new_child);
+        return branch.page_id();
+    }
+
+    if (tx.CopyNeeded(branch.last_modified_txid())) {
+        branch = BranchNode(this, branch.Copy().Release());
+    }
+    if (!end) {
+        // All children after the one holding begin are in the range
+        for (SlotId slot_id = first + 1; slot_id <= branch.count(); ++slot_id) {
+            FreeTree(branch.GetLeftChild(slot_id));
+        }
+        while (branch.count() > first) {
+            branch.Pop(true);
+        }
+        branch.SetTailChild(DeleteRange(branch.GetTailChild(), begin, nullptr));
+        return branch.page_id();
+    }
+    if (!begin) {
+        // All children before the one holding end are in the range
+        for (SlotId slot_id = 0; slot_id < last; ++slot_id) {
+            FreeTree(branch.GetLeftChild(slot_id));
+        }
+        for (SlotId i = 0; i < last; ++i) {
+            branch.Delete(0, false);
+        }
+        branch.SetLeftChild(0, DeleteRange(branch.GetLeftChild(0), nullptr, end));
+        return branch.page_id();
+    }
+
+    for (SlotId slot_id = first + 1; slot_id < last; ++slot_id) {
+        FreeTree(branch.GetLeftChild(slot_id));
+    }
+    for (SlotId i = first + 1; i < last; ++i) {
+        branch.Delete(first + 1, false);
+    }
+    // The paths of the two bounds split here, below it each one only has one bound
+    branch.SetLeftChild(first, DeleteRange(branch.GetLeftChild(first), begin, nullptr));
+    branch.SetLeftChild(first + 1, DeleteRange(branch.GetLeftChild(first + 1), nullptr, end));
+    return branch.page_id();
+}
+
+void BTree::FreeTree(PageId pgid) {
+    auto node = Node(this, pgid, false);
+    if (node.IsBranch()) {
+        auto branch = BranchNode(this, node.AddReference().Release());
+        for (SlotId slot_id = 0; slot_id <= branch.count(); ++slot_id) {
+            FreeTree(branch.GetLeftChild(slot_id));
+        }
+    } else {
+        auto leaf = LeafNode(this, node.AddReference().Release());
+        for (SlotId slot_id = 0; slot_id < leaf.count(); ++slot_id) {
+            if (!leaf.IsBucket(slot_id)) {
+                continue;
+            }
+            PageId sub_root_pgid;
+            std::memcpy(&sub_root_pgid, leaf.GetValue(slot_id).data(), sizeof(sub_root_pgid));
+            if (sub_root_pgid != kPageInvalidId) {
+                FreeTree(sub_root_pgid);
+            }
+        }
+    }
+    node.FreeOverflowPages();
+    bucket_->pager().Free(pgid, 1);
+}
+
+std::optional<size_t> BTree::FindEmptyNode(Iterator* iter, std::span<const uint8_t> key) {
+    std::optional<size_t> below_count;
+    PageId pgid = root_pgid_;
+    while (true) {
+        auto node = Node(this, pgid, false);
+        if (below_count.has_value()) {
+            ++*below_count;
+        } else if (!iter->Empty() && node.count() == 0) {
+            below_count = 0;
+        }
+        if (node.IsLeaf()) {
+            iter->Push({ pgid, 0 });
+            return below_count;
+        }
+        auto branch = BranchNode(this, node.Release());
+        auto [slot_id, eq] = branch.LowerBound(key);
+        if (eq) {
+            ++slot_id;
+        }
+        iter->Push({ pgid, slot_id });
+        pgid = branch.GetLeftChild(slot_id);
+    }
+}
+
 BTree::Iterator BTree::begin() noexcept {
     auto iter = Iterator(this);
     iter.First(root_pgid_);
@@ -167,7 +585,10 @@ void BTree::Merge(BranchNode&& left, BranchNode&& right, std::span<const uint8_t
 
 void BTree::Delete(Iterator* iter, BranchNode&& node, SlotId left_del_slot_id) {
     node.Delete(left_del_slot_id, true);
+    Rebalance(iter, std::move(node));
+}
 
+void BTree::Rebalance(Iterator* iter, BranchNode&& node) {
     if (iter->Empty()) {
         // If there is no parent node
         // Check if there are no child nodes; if true, change the last remaining child node to the root node
@@ -273,10 +694,15 @@ void BTree::Merge(LeafNode&& left, LeafNode&& right) {
 
 void BTree::Delete(Iterator* iter) {
     assert(!iter->is_bucket() || iter->is_bucket() && iter->value<PageId>() == kPageInvalidId);
+    rightmost_pgid_ = kPageInvalidId;
 
     auto [pgid, pos] = iter->Front();
     auto node = LeafNode(this, pgid, true);
     node.Delete(pos);
+    Rebalance(iter, std::move(node));
+}
+
+void BTree::Rebalance(Iterator* iter, LeafNode&& node) {
     if (node.GetFillRate() >= 0.4) {
         return;
     }
@@ -347,7 +773,17 @@ void BTree::Delete(Iterator* iter) {
     Delete(iter, std::move(parent), parent_slot_id);
 }
 
-std::tuple<std::span<const uint8_t>, BranchNode> BTree::Split(BranchNode* left, SlotId insert_slot_id, std::span<const uint8_t> insert_key, PageId insert_right_child) {
+BTree::SplitPolicy BTree::GetSplitPolicy(const Iterator& iter, Node& node, SlotId insert_slot_id) const {
+    if (insert_slot_id == node.count() && iter.IsRightmostPath()) {
+        return SplitPolicy::kAppend;
+    }
+    if (insert_slot_id == 0 && iter.IsLeftmostPath()) {
+        return SplitPolicy::kPrepend;
+    }
+    return SplitPolicy::kHalf;
+}
+
+std::tuple<std::span<const uint8_t>, BranchNode> BTree::Split(BranchNode* left, SlotId insert_slot_id, std::span<const uint8_t> insert_key, PageId insert_right_child, SplitPolicy policy) {
     assert(insert_slot_id <= left->count());
     
     auto right = BranchNode(this, bucket_->pager().Alloc(1), true);
@@ -360,20 +796,26 @@ std::tuple<std::span<const uint8_t>, BranchNode> BTree::Split(BranchNode* left,
     PageId insert_left_child = left->GetLeftChild(insert_slot_id);
     left->SetLeftChild(insert_slot_id, insert_right_child);
 
-    for (int16_t i = saved_left_count - 1; i >= 0; --i) {
-        auto success = right.Append(left->GetKey(i), left->GetLeftChild(i), false);
-        assert(success);
-        left->Pop(false);
-        if (left->GetFillRate() <= 0.5) {
-            break;
+    // When appending the elements stay on the left, the last one still rises below
+    if (policy != SplitPolicy::kAppend) {
+        for (int16_t i = saved_left_count - 1; i >= 0; --i) {
+            auto success = right.Append(left->GetKey(i), left->GetLeftChild(i), false);
+            assert(success);
+            left->Pop(false);
+            if (policy == SplitPolicy::kHalf && left->GetFillRate() <= 0.5) {
+                break;
+            }
         }
+        right.ReverseSlots();
+        assert(left->GetFillRate() <= 0.5);
     }
-    std::reverse(right.slots(), right.slots() + right.count());
-    assert(left->GetFillRate() <= 0.5);
 
     right.SetTailChild(left->GetTailChild());
 
-    if (insert_slot_id > left->count()) {
+    if (policy == SplitPolicy::kAppend) {
+        auto success = right.Insert(0, insert_key, insert_left_child, false);
+        assert(success);
+    } else if (insert_slot_id > left->count()) {
         auto success = right.Insert(insert_slot_id - left->count(), insert_key, insert_left_child, false);
         if (!success) {
             success = left->Append(right.GetKey(0), right.GetLeftChild(0), true);
@@ -426,12 +868,25 @@ void BTree::Put(Iterator* iter, Node&& left, Node&& right, std::span<const uint8
         return;
     }
 
-    auto [branch_key, branch_right] = Split(&node, slot_id, key, right.page_id());
+    auto [branch_key, branch_right] = Split(&node, slot_id, key, right.page_id(), GetSplitPolicy(*iter, node, slot_id));
     iter->Pop();
     Put(iter, std::move(node), std::move(branch_right), branch_key);
 }
 
-LeafNode BTree::Split(LeafNode* left, SlotId insert_slot_id, std::span<const uint8_t> key, std::span<const uint8_t> value, bool is_bucket) {
+std::span<const uint8_t> BTree::SeparatorKey(std::span<const uint8_t> left_max, std::span<const uint8_t> right_min) const {
+    if (comparator_.ptr_ != ByteArrayCompFunc) {
+        return right_min;
+    }
+    // The first differing byte of right_min is greater, the prefix ending with it is still greater than left_max
+    const auto common_size = static_cast<size_t>(std::mismatch(left_max.begin(), left_max.end(), right_min.begin(), right_min.end()).first - left_max.begin());
+    if (common_size >= right_min.size()) {
+        // Duplicate keys cannot be separated
+        return right_min;
+    }
+    return right_min.first(common_size + 1);
+}
+
+LeafNode BTree::Split(LeafNode* left, SlotId insert_slot_id, std::span<const uint8_t> key, std::span<const uint8_t> value, bool is_bucket, SplitPolicy policy) {
     assert(insert_slot_id <= left->count());
 
     auto right = LeafNode(this, bucket_->pager().Alloc(1), true);
@@ -441,16 +896,25 @@ LeafNode BTree::Split(LeafNode* left, SlotId insert_slot_id, std::span<const uin
     assert(saved_left_count >= 2);
     assert(left->GetFillRate() > 0.5);
 
+    if (policy == SplitPolicy::kAppend) {
+        // The new element starts the right node
+        assert(insert_slot_id == left->count());
+        auto success = right.Insert(0, key, value);
+        assert(success);
+        right.SetIsBucket(0, is_bucket);
+        return right;
+    }
+
     for (SlotId i = saved_left_count - 1; i >= 0; --i) {
         auto success = right.Append(left->GetKey(i), left->GetValue(i));
         assert(success);
         right.SetIsBucket(right.count() - 1, left->IsBucket(i));
         left->Pop();
-        if (left->GetFillRate() <= 0.5) {
+        if (policy == SplitPolicy::kHalf && left->GetFillRate() <= 0.5) {
             break;
         }
     }
-    std::reverse(right.slots(), right.slots() + right.count());
+    right.ReverseSlots();
     assert(left->GetFillRate() <= 0.5);
 
     // If the fill rate of the node is >50%, the insertion may fail
@@ -491,22 +955,54 @@ void BTree::Put(Iterator* iter, std::span<const uint8_t> key, std::span<const ui
     auto node = LeafNode(this, pgid, true);
     if (!insert_only && iter->status() == Iterator::Status::kEq) {
         assert(iter->is_bucket() == is_bucket);
-        node.Update(slot_id, key, value);
-        node.SetIsBucket(slot_id, is_bucket);
-        return;
+        if (node.Update(slot_id, key, value)) {
+            node.SetIsBucket(slot_id, is_bucket);
+            return;
+        }
+        // The new record does not fit in the node, replace it by inserting, which may split
+        node.Delete(slot_id);
     }
 
     if (node.Insert(slot_id, key, value)) {
         node.SetIsBucket(slot_id, is_bucket);
+        if (slot_id == node.count() - 1 && iter->IsRightmostPath()) {
+            rightmost_pgid_ = node.page_id();
+        }
         return;
     }
 
     // Needs to split and then insert upward
-    LeafNode right = Split(&node, slot_id, key, value, is_bucket);
+    const auto policy = GetSplitPolicy(*iter, node, slot_id);
+    LeafNode right = Split(&node, slot_id, key, value, is_bucket, policy);
+    // The new right node becomes the rightmost leaf, the branch splits above do not move it
+    rightmost_pgid_ = policy == SplitPolicy::kAppend ? right.page_id() : kPageInvalidId;
     
     iter->Pop();
-    // Promote the first key of the right node
-    Put(iter, std::move(node), std::move(right), right.GetKey(0));
+    // Promote the shortest key separating the two nodes
+    auto separator = SeparatorKey(node.GetKey(node.count() - 1), right.GetKey(0));
+    Put(iter, std::move(node), std::move(right), separator);
+}
+
+bool BTree::PutRightmost(std::span<const uint8_t> key, std::span<const uint8_t> value, bool is_bucket) {
+    if (rightmost_pgid_ == kPageInvalidId) {
+        return false;
+    }
+    auto node = LeafNode(this, rightmost_pgid_, true);
+    if (bucket_->tx().CopyNeeded(node.last_modified_txid())) {
+        rightmost_pgid_ = kPageInvalidId;
+        return false;
+    }
+    assert(node.IsLeaf() && node.count() > 0);
+    // All the keys of the tree are less than or equal to the last key of the rightmost leaf
+    if (comparator_.ptr_(key, node.GetKey(node.count() - 1)) <= 0) {
+        return false;
+    }
+    // A full leaf takes the regular path to split
+    if (!node.Insert(node.count(), key, value)) {
+        return false;
+    }
+    node.SetIsBucket(node.count() - 1, is_bucket);
+    return true;
 }
 
 } // namespace atomkv
\ No newline at end of file
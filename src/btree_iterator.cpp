@@ -13,6 +13,8 @@
 #include <atomkv/bucket_impl.h>
 #include <atomkv/tx_impl.h>
 
+#include "pager.h"
+
 namespace atomkv {
 
 BTreeIterator::BTreeIterator(BTree* btree) 
@@ -108,8 +110,7 @@ std::pair<LeafNode&, SlotId> BTreeIterator::GetLeafNode(bool dirty) const {
 
 std::span<const uint8_t> BTreeIterator::GetKey() const {
     auto [node, slot_id] = GetLeafNode(false);
-    auto span = node.GetKey(slot_id);
-    return span;
+    return node.GetKey(slot_id, &key_buf_);
 }
 
 std::span<const uint8_t> BTreeIterator::GetValue() const {
@@ -148,10 +149,9 @@ void BTreeIterator::Last(PageId pgid) {
             }
             break;
         }
-        Push({ pgid, node.count() - 1 });
-        assert(node.count() > 0);
+        Push({ pgid, node.count() });
         auto branch_node = BranchNode(btree_, node.Release());
-        pgid = branch_node.GetLeftChild(node.count() - 1);
+        pgid = branch_node.GetTailChild();
     } while (true);
     Node node{ btree_, pgid, false };
     Push({ pgid, node.count() - 1 });
@@ -169,17 +169,59 @@ void BTreeIterator::Next() {
             }
             auto branch_node = BranchNode(btree_, node.Release());
             First(branch_node.GetLeftChild(slot_id));
+            PrefetchLeaves();
             return;
         }
         if (node.IsBranch() && slot_id == node.count()) {
             auto branch_node = BranchNode(btree_, node.Release());
             First(branch_node.GetTailChild());
+            PrefetchLeaves();
             return;
         }
         Pop();
     } while (!Empty());
 }
 
+void BTreeIterator::PrefetchLeaves() {
+    // The parent of the leaf just reached lists the following leaves,
+    // read them in while the keys of this one are processed
+    if (stack_.size() < 2) {
+        return;
+    }
+    auto& [parent_pgid, parent_slot_id] = stack_[stack_.size() - 2];
+    const SlotId prefetch_count = sequential_ ? kSequentialPrefetchLeafCount : kPrefetchLeafCount;
+    if (parent_pgid != prefetch_pgid_) {
+        prefetch_pgid_ = parent_pgid;
+        prefetch_slot_id_ = parent_slot_id;
+    }
+    else if (parent_slot_id + prefetch_count / 2 < prefetch_slot_id_) {
+        return;
+    }
+
+    auto parent = BranchNode(btree_, parent_pgid, false);
+    auto& pager = btree_->bucket().pager();
+    const SlotId end_slot_id = std::min<SlotId>(parent_slot_id + prefetch_count, parent.count());
+    // Adjacent leaves are prefetched together
+    PageId run_pgid = kPageInvalidId;
+    PageCount run_count = 0;
+    for (SlotId slot_id = prefetch_slot_id_ + 1; slot_id <= end_slot_id; ++slot_id) {
+        const PageId pgid = slot_id == parent.count() ? parent.GetTailChild() : parent.GetLeftChild(slot_id);
+        if (run_count > 0 && pgid == run_pgid + run_count) {
+            ++run_count;
+            continue;
+        }
+        if (run_count > 0) {
+            pager.Prefetch(run_pgid, run_count);
+        }
+        run_pgid = pgid;
+        run_count = 1;
+    }
+    if (run_count > 0) {
+        pager.Prefetch(run_pgid, run_count);
+    }
+    prefetch_slot_id_ = std::max(prefetch_slot_id_, end_slot_id);
+}
+
 void BTreeIterator::Prev() {
     if (Empty()) {
         Last(btree_->root_pgid_);
@@ -266,6 +308,68 @@ bool BTreeIterator::Empty() const {
     return stack_.empty();
 }
 
+bool BTreeIterator::IsRightmostPath() const {
+    for (size_t i = 0; i + 1 < stack_.size(); ++i) {
+        auto& [pgid, slot_id] = stack_[i];
+        if (slot_id != BranchNode(btree_, pgid, false).count()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BTreeIterator::IsLeftmostPath() const {
+    for (size_t i = 0; i + 1 < stack_.size(); ++i) {
+        if (stack_[i].second != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BTreeIterator::SeekInLeaf(std::span<const uint8_t> key) {
+    if (Empty() || stack_[0].first != btree_->root_pgid_) {
+        return false;
+    }
+    // Writes since the path was searched may have copied or restructured its pages,
+    // it is still valid if every child on it is still linked from its parent
+    for (size_t i = 0; i + 1 < stack_.size(); ++i) {
+        auto& [pgid, slot_id] = stack_[i];
+        auto node = Node(btree_, pgid, false);
+        if (!node.IsBranch() || slot_id > node.count()) {
+            return false;
+        }
+        if (BranchNode(btree_, node.Release()).GetLeftChild(slot_id) != stack_[i + 1].first) {
+            return false;
+        }
+    }
+
+    auto& [pgid, slot_id] = Front();
+    cached_node_.emplace(btree_, pgid, false);
+    if (!cached_node_->IsLeaf() || cached_node_->count() == 0) {
+        return false;
+    }
+    // Keys between the first and last keys can only be in this leaf, the edges of the tree bound the rest
+    auto& comparator = btree_->comparator();
+    if (comparator(key, cached_node_->GetKey(0)) < 0 && !IsLeftmostPath()) {
+        return false;
+    }
+    if (comparator(key, cached_node_->GetKey(cached_node_->count() - 1)) > 0 && !IsRightmostPath()) {
+        return false;
+    }
+
+    auto [new_slot_id, eq] = cached_node_->LowerBound(key);
+    slot_id = new_slot_id;
+    if (eq) {
+        status_ = Status::kEq;
+    } else if (slot_id == cached_node_->count()) {
+        status_ = Status::kInvalid;
+    } else {
+        status_ = Status::kNe;
+    }
+    return true;
+}
+
 void BTreeIterator::CopyAllPagesByPath() {
     if (Empty()) {
         return;
@@ -9,11 +9,16 @@
 
 #include "atomkv/bucket_impl.h"
 
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
 #include "atomkv/bucket.h"
 
 #include "db_impl.h"
 #include "tx_manager.h"
 #include "pager.h"
+#include "log_type.h"
 
 namespace atomkv {
 
@@ -23,21 +28,52 @@ BucketImpl::BucketImpl(TxImpl* tx, BucketId bucket_id, PageId* root_pgid, bool w
     , writable_(writable)
     , btree_(this, root_pgid, comparator) {}
 
-BucketImpl::~BucketImpl() = default;
+BucketImpl::~BucketImpl() {
+    if (loader_) {
+        loader_->bucket_ = nullptr;
+    }
+}
 
 bool BucketImpl::Empty() const {
     return btree_.Empty();
 }
 
 BucketImpl::Iterator BucketImpl::Get(const void* key_buf, size_t key_size) {
+    ThrowIfLoading();
     return Iterator(btree_.Get({ reinterpret_cast<const uint8_t*>(key_buf), key_size }));
 }
 
+std::vector<std::optional<std::string_view>> BucketImpl::MultiGet(std::span<const std::string_view> keys) {
+    ThrowIfLoading();
+    std::vector<std::span<const uint8_t>> key_spans;
+    key_spans.reserve(keys.size());
+    for (auto& key : keys) {
+        key_spans.push_back({ reinterpret_cast<const uint8_t*>(key.data()), key.size() });
+    }
+    std::vector<std::optional<std::span<const uint8_t>>> value_spans(keys.size());
+    btree_.MultiGet(key_spans, value_spans);
+
+    std::vector<std::optional<std::string_view>> values(keys.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (value_spans[i].has_value()) {
+            values[i] = std::string_view{ reinterpret_cast<const char*>(value_spans[i]->data()), value_spans[i]->size() };
+        }
+    }
+    return values;
+}
+
 BucketImpl::Iterator BucketImpl::LowerBound(const void* key_buf, size_t key_size) {
-    return Iterator(btree_.LowerBound({ reinterpret_cast<const uint8_t*>(key_buf), key_size }));
+    ThrowIfLoading();
+    auto iter = btree_.LowerBound({ reinterpret_cast<const uint8_t*>(key_buf), key_size });
+    // A key past the last key of a leaf other than the last one is positioned at the end of that leaf
+    if (iter.status() == BTreeIterator::Status::kInvalid && !iter.Empty()) {
+        iter.Next();
+    }
+    return Iterator(iter);
 }
 
 void BucketImpl::Put(const void* key_buf, size_t key_size, const void* value_buf, size_t value_size, bool is_bucket) {
+    ThrowIfLoading();
     auto key_span = std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(key_buf), key_size);
     auto value_span = std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(value_buf), value_size);
     tx_->AppendPutLog(bucket_id_, key_span, value_span, is_bucket);
@@ -45,7 +81,17 @@ void BucketImpl::Put(const void* key_buf, size_t key_size, const void* value_buf
     btree_.Put(key_span, value_span, is_bucket);
 }
 
+void BucketImpl::Put(const Iterator& hint, const void* key_buf, size_t key_size, const void* value_buf, size_t value_size, bool is_bucket) {
+    ThrowIfLoading();
+    auto key_span = std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(key_buf), key_size);
+    auto value_span = std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(value_buf), value_size);
+    tx_->AppendPutLog(bucket_id_, key_span, value_span, is_bucket);
+
+    btree_.Put(hint.iter_, key_span, value_span, is_bucket);
+}
+
 void BucketImpl::Update(Iterator* iter, const void* value_buf, size_t value_size) {
+    ThrowIfLoading();
     auto key = iter->key();
     auto key_span = std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(key.data()), key.size());
     tx_->AppendPutLog(bucket_id_, key_span, 
@@ -54,16 +100,129 @@ void BucketImpl::Update(Iterator* iter, const void* value_buf, size_t value_size
 }
 
 bool BucketImpl::Delete(const void* key_buf, size_t key_size) {
+    ThrowIfLoading();
     auto key_span = std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(key_buf), key_size);
     tx_->AppendDeleteLog(bucket_id_, key_span);
     return btree_.Delete(key_span);
 }
 
+bool BucketImpl::Delete(const Iterator& hint, const void* key_buf, size_t key_size) {
+    ThrowIfLoading();
+    auto key_span = std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(key_buf), key_size);
+    tx_->AppendDeleteLog(bucket_id_, key_span);
+    return btree_.Delete(hint.iter_, key_span);
+}
+
+void BucketImpl::DeleteRange(const void* begin_buf, size_t begin_size, const void* end_buf, size_t end_size) {
+    ThrowIfLoading();
+    auto begin_span = std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(begin_buf), begin_size);
+    auto end_span = std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(end_buf), end_size);
+    // The roots of opened sub buckets are written back on commit, their trees must stay
+    if (sub_bucket_map_.has_value()) {
+        for (auto& [key, value] : *sub_bucket_map_) {
+            auto key_span = std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(key.data()), key.size());
+            if (btree_.comparator()(key_span, begin_span) >= 0 && btree_.comparator()(key_span, end_span) < 0) {
+                throw std::invalid_argument("attempt to delete a range containing an opened sub bucket.");
+            }
+        }
+    }
+    tx_->AppendDeleteRangeLog(bucket_id_, begin_span, end_span);
+    btree_.DeleteRange(begin_span, end_span);
+}
+
 void BucketImpl::Delete(Iterator* iter) {
+    ThrowIfLoading();
     btree_.Delete(&iter->iter_);
 }
 
+void BucketImpl::Write(const WriteBatch& batch) {
+    Write({ reinterpret_cast<const uint8_t*>(batch.rep_.data()), batch.rep_.size() });
+}
+
+void BucketImpl::Write(std::span<const uint8_t> batch) {
+    ThrowIfLoading();
+    if (batch.empty()) {
+        return;
+    }
+
+    auto read_size = [&](size_t* offset) {
+        uint32_t size;
+        if (*offset + sizeof(size) > batch.size()) {
+            throw std::invalid_argument("Corrupted write batch.");
+        }
+        std::memcpy(&size, batch.data() + *offset, sizeof(size));
+        *offset += sizeof(size);
+        if (*offset + size > batch.size()) {
+            throw std::invalid_argument("Corrupted write batch.");
+        }
+        return size;
+    };
+    std::vector<BTree::BatchWrite> writes;
+    size_t offset = 0;
+    while (offset < batch.size()) {
+        auto type = static_cast<LogType>(batch[offset++]);
+        if (type != LogType::kPut_NotBucket && type != LogType::kDelete) {
+            throw std::invalid_argument("Corrupted write batch.");
+        }
+        BTree::BatchWrite write{ .key = {}, .value = {}, .is_delete = type == LogType::kDelete };
+        auto key_size = read_size(&offset);
+        write.key = batch.subspan(offset, key_size);
+        offset += key_size;
+        if (!write.is_delete) {
+            auto value_size = read_size(&offset);
+            write.value = batch.subspan(offset, value_size);
+            offset += value_size;
+        }
+        writes.push_back(write);
+    }
+
+    // One log covers the whole batch, written once it is known to apply
+    tx_->AppendBatchLog(bucket_id_, batch);
+
+    // Sort by key, keeping only the last write of each key
+    auto& comparator = btree_.comparator();
+    std::stable_sort(writes.begin(), writes.end(), [&](const BTree::BatchWrite& a, const BTree::BatchWrite& b) {
+        return comparator(a.key, b.key) < 0;
+    });
+    auto last = std::unique(writes.rbegin(), writes.rend(), [&](const BTree::BatchWrite& a, const BTree::BatchWrite& b) {
+        return comparator(a.key, b.key) == 0;
+    });
+    writes.erase(writes.begin(), last.base());
+
+    btree_.Write(writes);
+}
+
+void BucketImpl::BeginBulkLoad(double fill_factor) {
+    btree_.BeginLoad(fill_factor);
+    load_batch_.Clear();
+}
+
+void BucketImpl::BulkLoad(const void* key_buf, size_t key_size, const void* value_buf, size_t value_size) {
+    constexpr size_t kLoadLogSize = 1024 * 1024;
+    auto key_span = std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(key_buf), key_size);
+    auto value_span = std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(value_buf), value_size);
+    btree_.Load(key_span, value_span);
+
+    // Recovery replays the records as batches of ordinary writes
+    if (tx_->tx_manager().db().options()->mode == DbMode::kWal) {
+        load_batch_.Put(key_buf, key_size, value_buf, value_size);
+        if (load_batch_.rep_.size() >= kLoadLogSize) {
+            tx_->AppendBatchLog(bucket_id_, { reinterpret_cast<const uint8_t*>(load_batch_.rep_.data()), load_batch_.rep_.size() });
+            load_batch_.Clear();
+        }
+    }
+}
+
+void BucketImpl::FinishBulkLoad() {
+    if (!load_batch_.empty()) {
+        tx_->AppendBatchLog(bucket_id_, { reinterpret_cast<const uint8_t*>(load_batch_.rep_.data()), load_batch_.rep_.size() });
+        load_batch_.Clear();
+    }
+    btree_.FinishLoad();
+}
+
 BucketImpl& BucketImpl::SubBucket(std::string_view key, bool writable) {
+    ThrowIfLoading();
     if (!sub_bucket_map_.has_value()) {
         sub_bucket_map_.emplace();
     }
@@ -93,6 +252,29 @@ BucketImpl& BucketImpl::SubBucket(std::string_view key, bool writable) {
     return tx_->AtSubBucket(bucket_id);
 }
 
+void BucketImpl::RenewSubBuckets(TxId old_txid) {
+    assert(!writable_);
+    if (!sub_bucket_map_.has_value()) {
+        return;
+    }
+    for (auto& [key, value] : *sub_bucket_map_) {
+        auto& [bucket_id, root_pgid] = value;
+        auto iter = Get(key.data(), key.size());
+        // A sub bucket deleted since then is seen as empty
+        PageId new_root_pgid = kPageInvalidId;
+        if (iter != end() && iter.is_bucket()) {
+            new_root_pgid = iter.value<PageId>();
+        }
+        auto& sub_bucket = tx_->AtSubBucket(bucket_id);
+        if (new_root_pgid == root_pgid && !sub_bucket.btree().RootModifiedAfter(old_txid)) {
+            // Copy on write, an unchanged root means the whole sub tree is unchanged
+            continue;
+        }
+        root_pgid = new_root_pgid;
+        sub_bucket.RenewSubBuckets(old_txid);
+    }
+}
+
 bool BucketImpl::DeleteSubBucket(std::string_view key) {
     auto iter = Get(key.data(), key.size());
     if (iter == end()) {
@@ -103,6 +285,7 @@ bool BucketImpl::DeleteSubBucket(std::string_view key) {
 }
 
 void BucketImpl::DeleteSubBucket(Iterator* iter) {
+    ThrowIfLoading();
     if (!iter->is_bucket()) {
         throw std::invalid_argument("attempt to delete a key value pair that is not a sub bucket.");
     }
@@ -141,6 +324,13 @@ BucketImpl::Iterator BucketImpl::end() noexcept {
 
 Pager& BucketImpl::pager() const { return tx_->pager(); }
 
+void BucketImpl::ThrowIfLoading() const {
+    // The load builds the tree aside and replaces the root when finished
+    if (btree_.loading()) {
+        throw std::runtime_error("attempt to access a bucket that is being bulk loaded.");
+    }
+}
+
 
 ViewBucket::ViewBucket(BucketImpl* bucket) : bucket_{ bucket } {};
 
@@ -158,6 +348,10 @@ ViewBucket::Iterator ViewBucket::Get(std::string_view key) const {
     return Get(key.data(), key.size());
 }
 
+std::vector<std::optional<std::string_view>> ViewBucket::MultiGet(std::span<const std::string_view> keys) const {
+    return bucket_->MultiGet(keys);
+}
+
 ViewBucket::Iterator ViewBucket::LowerBound(const void* key_buf, size_t key_size) const {
     return bucket_->LowerBound(key_buf, key_size);
 }
@@ -201,5 +395,74 @@ bool UpdateBucket::Delete(std::string_view key) {
     return bucket_->Delete(key.data(), key.size());
 }
 
+void UpdateBucket::DeleteRange(const void* begin_buf, size_t begin_size, const void* end_buf, size_t end_size) {
+    bucket_->DeleteRange(begin_buf, begin_size, end_buf, end_size);
+}
+
+void UpdateBucket::DeleteRange(std::string_view begin, std::string_view end) {
+    DeleteRange(begin.data(), begin.size(), end.data(), end.size());
+}
+
+void UpdateBucket::Put(const Iterator& hint, const void* key_buf, size_t key_size, const void* value_buf, size_t value_size) {
+    bucket_->Put(hint, key_buf, key_size, value_buf, value_size, false);
+}
+
+void UpdateBucket::Put(const Iterator& hint, std::string_view key, std::string_view value) {
+    Put(hint, key.data(), key.size(), value.data(), value.size());
+}
+
+bool UpdateBucket::Delete(const Iterator& hint, const void* key_buf, size_t key_size) {
+    return bucket_->Delete(hint, key_buf, key_size);
+}
+
+bool UpdateBucket::Delete(const Iterator& hint, std::string_view key) {
+    return bucket_->Delete(hint, key.data(), key.size());
+}
+
+void UpdateBucket::Write(const WriteBatch& batch) {
+    bucket_->Write(batch);
+}
+
+BulkLoader UpdateBucket::BulkLoad(double fill_factor) {
+    bucket_->BeginBulkLoad(fill_factor);
+    return BulkLoader(bucket_);
+}
+
+
+BulkLoader::BulkLoader(BucketImpl* bucket) : bucket_{ bucket } {
+    bucket_->set_loader(this);
+}
+
+BulkLoader::BulkLoader(BulkLoader&& right) noexcept : bucket_{ right.bucket_ } {
+    right.bucket_ = nullptr;
+    if (bucket_) {
+        bucket_->set_loader(this);
+    }
+}
+
+BulkLoader::~BulkLoader() {
+    if (bucket_) {
+        bucket_->set_loader(nullptr);
+    }
+}
+
+void BulkLoader::Add(const void* key_buf, size_t key_size, const void* value_buf, size_t value_size) {
+    if (!bucket_ || !bucket_->btree().loading()) {
+        throw std::runtime_error("The bulk load has finished.");
+    }
+    bucket_->BulkLoad(key_buf, key_size, value_buf, value_size);
+}
+
+void BulkLoader::Add(std::string_view key, std::string_view value) {
+    Add(key.data(), key.size(), value.data(), value.size());
+}
+
+void BulkLoader::Finish() {
+    if (!bucket_ || !bucket_->btree().loading()) {
+        throw std::runtime_error("The bulk load has finished.");
+    }
+    bucket_->FinishBulkLoad();
+}
+
 
 } // namespace atomkv
\ No newline at end of file
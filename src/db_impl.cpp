@@ -9,6 +9,17 @@
 
 #include "db_impl.h"
 
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#include <cerrno>
+#include <system_error>
+
 #include <wal/tinyio.hpp>
 #include <wal/crc32.h>
 
@@ -39,6 +50,15 @@ std::unique_ptr<DB> DB::Open(const Options& options, const std::string_view path
         }
     }
 
+    for (size_t size : { db_options.map_size, db_options.initial_size, db_options.growth_step, db_options.max_size, db_options.shrink_threshold }) {
+        if (size % db_options.page_size) {
+            throw std::invalid_argument("Options geometry must be a multiple of the page size.");
+        }
+    }
+    if (db_options.max_readers == 0) {
+        throw std::invalid_argument("Options max readers must be at least 1.");
+    }
+
     db->db_path_ = path;
     db_file.open(db->db_path_, tinyio::access_mode::sync_needed);
     db_file.lock(tinyio::share_mode::exclusive);
@@ -46,22 +66,26 @@ std::unique_ptr<DB> DB::Open(const Options& options, const std::string_view path
     bool init_meta = false;
     if (!db_options.read_only) {
         if (db_file.size() == 0) {
-            db_file.resize(db->options_->page_size * kPageInitCount);
             init_meta = true;
         }
     }
 
-    db->InitDBFile();
+    db->InitDBFile(init_meta);
 
     db->InitShmFile();
 
-    db->meta_.emplace(db.get(), &db->shm_->meta_struct());
+    db->meta_.emplace(db.get(), &db->shm_->meta_struct(), &db->shm_->view_meta_struct(), &db->shm_->meta_sequence());
     auto& db_meta = db->meta();
 
     if (init_meta) {
         db_meta.Init();
     } else {
         db_meta.Load();
+        // Free pages at the end may have been truncated before the meta was saved
+        const uint64_t min_size = static_cast<uint64_t>(db_meta.meta_struct().page_count) * db_options.page_size;
+        if (!db_options.read_only && min_size > db->db_file_size()) {
+            db->Grow(min_size);
+        }
     }
 
     db->pager_.emplace(db.get(), db->options_->page_size);
@@ -91,6 +115,7 @@ DBImpl::~DBImpl() {
     uint64_t new_size = 0;
     if (meta_.has_value()) {
         new_size = options_->page_size * meta_->meta_struct().page_count;
+        new_size = std::max<uint64_t>(new_size, options_->initial_size);
     }
 
     meta_.reset();
@@ -116,6 +141,11 @@ DBImpl::~DBImpl() {
         }
         db_file_.unlock();
     }
+#ifdef __linux__
+    if (db_fd_ != -1) {
+        ::close(db_fd_);
+    }
+#endif
  }
 
 UpdateTx DBImpl::Update() {
@@ -129,31 +159,82 @@ ViewTx DBImpl::View() {
     return tx_manager_->View();
  }
 
-void DBImpl::Remmap(uint64_t new_size) {
-     db_mmap_pending_.emplace_back(std::move(db_mmap_));
-     // Double expansion before 1GB
-     uint64_t map_size;
+OptimisticTx DBImpl::OptimisticUpdate() {
+    if (options_->read_only) {
+        throw std::runtime_error("the database is read-only.");
+    }
+    tx_manager_->CheckWritable();
+    return OptimisticTx(&*tx_manager_);
+ }
+
+void DBImpl::Grow(uint64_t min_size) {
+     uint64_t new_size;
      const uint64_t max_expand_size = 1024 * 1024 * 1024;
-     if (new_size <= max_expand_size) {
-         map_size = 1;
+     if (options_->growth_step > 0) {
+         new_size = (min_size + options_->growth_step - 1) / options_->growth_step * options_->growth_step;
+     }
+     // Double expansion before 1GB
+     else if (min_size <= max_expand_size) {
+         new_size = 1;
          for (uint32_t i = 0; i < 31; ++i) {
-             map_size *= 2;
-             if (map_size > new_size) {
+             new_size *= 2;
+             if (new_size > min_size) {
                  break;
              }
          }
      }
      else {
-         map_size = new_size + (new_size % max_expand_size);
+         new_size = (min_size + max_expand_size - 1) / max_expand_size * max_expand_size;
+     }
+
+     uint64_t max_size = options_->max_size;
+     if (mmap_reserved_ && (max_size == 0 || max_size > db_mmap_.size())) {
+         max_size = db_mmap_.size();
+     }
+     if (max_size > 0) {
+         if (min_size > max_size) {
+             throw std::runtime_error("The database has reached its maximum size.");
+         }
+         new_size = std::min(new_size, max_size);
      }
-     assert(map_size % pager_->page_size() == 0);
+     assert(new_size % options_->page_size == 0);
+
+     if (!mmap_reserved_) {
+         Remmap(new_size);
+         return;
+     }
+     // The reserved mapping already covers the new pages, only the file needs to grow
+     ResizeDBFile(new_size);
+ }
 
-     db_file_.resize(map_size);
+void DBImpl::Shrink(uint64_t new_size) {
+#ifndef _WIN32
+     // Windows cannot truncate a mapped file, it is truncated when closed
+     new_size = std::max<uint64_t>(new_size, options_->initial_size);
+     if (new_size < db_file_size_) {
+         ResizeDBFile(new_size);
+     }
+#endif
+ }
+
+void DBImpl::Remmap(uint64_t new_size) {
+     // The background checkpoint is syncing the current mapping
+     if (logger_.has_value()) {
+         logger_->WaitCheckpoint();
+     }
+     // Or the background sync of the last commit
+     if (tx_manager_.has_value()) {
+         tx_manager_->WaitFlush();
+     }
+     db_mmap_pending_.emplace_back(std::move(db_mmap_));
+
+     ResizeDBFile(new_size);
      std::error_code ec;
      db_mmap_.map(db_path_, ec);
      if (ec) {
          throw std::system_error(ec, "Unable to map db file.");
      }
+     AdviseDBMmap();
  }
 
 void DBImpl::ClearPendingMmap() {
@@ -165,12 +246,74 @@ void DBImpl::ClearPendingMmap() {
      db_mmap_pending_.clear();
  }
 
-void DBImpl::InitDBFile() {
+void DBImpl::InitDBFile(bool init) {
+#ifdef __linux__
+    if (!options_->read_only) {
+        db_fd_ = ::open(db_path_.c_str(), O_RDWR);
+        if (db_fd_ == -1) {
+            throw std::system_error(errno, std::generic_category(), "Unable to open db file.");
+        }
+    }
+#endif
+    db_file_size_ = db_file_.size();
+    if (init) {
+        ResizeDBFile(std::max<uint64_t>(options_->initial_size, options_->page_size * kPageInitCount));
+    }
+
+    if (!options_->read_only && options_->map_size > db_file_size_) {
+        mmap_reserved_ = true;
+        // The mapping cannot exceed the file when it is created
+        db_file_.resize(options_->map_size);
+    }
+
     std::error_code ec;
     db_mmap_ = mio::make_mmap_sink(db_path_, ec);
     if (ec) {
         throw std::system_error(ec, "Unable to map db file.");
     }
+    AdviseDBMmap();
+
+    if (mmap_reserved_) {
+#ifdef _WIN32
+        // A mapped file cannot be truncated, it keeps the map size until closed
+        db_file_size_ = db_mmap_.size();
+#else
+        // Pages beyond the end of file stay mapped, so growing the file never moves the mapping
+        db_file_.resize(db_file_size_);
+#endif
+    }
+}
+
+void DBImpl::ResizeDBFile(uint64_t new_size) {
+#ifdef __linux__
+    if (new_size > db_file_size_ && db_fd_ != -1) {
+        // Allocate the blocks up front, rather than on page faults into a sparse file
+        const auto ret = ::posix_fallocate(db_fd_, db_file_size_, new_size - db_file_size_);
+        if (ret != 0 && ret != EOPNOTSUPP && ret != EINVAL) {
+            throw std::system_error(ret, std::generic_category(), "Unable to allocate db file.");
+        }
+    }
+#endif
+    db_file_.resize(new_size);
+    db_file_size_ = new_size;
+}
+
+void DBImpl::AdviseDBMmap() {
+#ifndef _WIN32
+    // The advice is only a hint, failures are ignored
+    auto addr = static_cast<void*>(db_mmap_.data());
+    const auto length = db_mmap_.size();
+    int advice = MADV_NORMAL;
+    if (options_->mmap_advice == MmapAdvice::kRandom) {
+        advice = MADV_RANDOM;
+    }
+    ::madvise(addr, length, advice);
+#ifdef MADV_HUGEPAGE
+    if (options_->huge_pages) {
+        ::madvise(addr, length, MADV_HUGEPAGE);
+    }
+#endif
+#endif
 }
 
 void DBImpl::InitShmFile() {
@@ -179,14 +322,15 @@ void DBImpl::InitShmFile() {
     std::filesystem::remove(shm_path, ec);
     tinyio::file shm_file;
     shm_file.open(shm_path, tinyio::access_mode::write);
-    if (shm_file.size() < sizeof(ShmStruct)) {
-        shm_file.resize(sizeof(ShmStruct));
+    const auto shm_size = Shm::Size(options_->max_readers);
+    if (shm_file.size() < shm_size) {
+        shm_file.resize(shm_size);
     }
     shm_mmap_ = mio::make_mmap_sink(shm_path, ec);
     if (ec) {
         throw std::system_error(ec, "Unable to map shm file.");
     }
-    shm_.emplace(reinterpret_cast<ShmStruct*>(shm_mmap_.data()));
+    shm_.emplace(reinterpret_cast<uint8_t*>(shm_mmap_.data()), options_->max_readers);
 }
 
 void DBImpl::InitLogFile() {
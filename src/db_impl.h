@@ -13,6 +13,7 @@
 #include <optional>
 #include <memory>
 #include <shared_mutex>
+#include <mutex>
 
 #include <mio/mio.hpp>
 
@@ -33,8 +34,10 @@ public:
 
     UpdateTx Update() override;
     ViewTx View() override;
+    OptimisticTx OptimisticUpdate() override;
 
-    void Remmap(uint64_t new_size);
+    void Grow(uint64_t min_size);
+    void Shrink(uint64_t new_size);
     void ClearPendingMmap();
 
     auto& options() const { return options_; }
@@ -45,6 +48,8 @@ public:
     auto& db_file_mmap() { return db_mmap_; }
     auto& db_file_mmap_lock() const { return db_mmap_lock_; }
     auto& db_file_mmap_lock() { return db_mmap_lock_; }
+    auto& db_file_mmap_reserved() const { return mmap_reserved_; }
+    auto& db_file_size() const { return db_file_size_; }
     auto& shm() const { return shm_; }
     auto& shm() { return shm_; }
     auto& meta() const { assert(meta_.has_value()); return *meta_; }
@@ -57,9 +62,13 @@ public:
     auto& logger() { return *logger_; }
 
 private:
-    void InitDBFile();
+    void InitDBFile(bool init);
     void InitShmFile();
     void InitLogFile();
+
+    void Remmap(uint64_t new_size);
+    void ResizeDBFile(uint64_t new_size);
+    void AdviseDBMmap();
     
 private:
     friend class DB;
@@ -68,7 +77,15 @@ private:
 
     std::string db_path_;
     tinyio::file db_file_;
+#ifdef __linux__
+    // For preallocating the file
+    int db_fd_{ -1 };
+#endif
+    uint64_t db_file_size_{ 0 };
     mio::mmap_sink db_mmap_;
+    // With Options::map_size the mapping is never moved,
+    // so read transactions do not need db_mmap_lock_
+    bool mmap_reserved_{ false };
     std::shared_mutex db_mmap_lock_;
     std::vector<mio::mmap_sink> db_mmap_pending_;
 
@@ -24,6 +24,8 @@ enum class LogType : uint8_t {
     kPut_IsBucket,
     kPut_NotBucket,
     kDelete,
+    kBatch,
+    kDeleteRange,
 };
 
 #pragma pack(push, 1)
@@ -42,5 +44,7 @@ constexpr size_t kBucketSubBucketLogHeaderSize = sizeof(BucketLogHeader);
 constexpr size_t kBucketPutLogHeaderSize = sizeof(BucketLogHeader);
 constexpr size_t kBucketUpdateLogHeaderSize = sizeof(BucketLogHeader);
 constexpr size_t kBucketDeleteLogHeaderSize = sizeof(BucketLogHeader);
+constexpr size_t kBucketBatchLogHeaderSize = sizeof(BucketLogHeader);
+constexpr size_t kBucketDeleteRangeLogHeaderSize = sizeof(BucketLogHeader);
 
 } // namespace atomkv
\ No newline at end of file
@@ -9,6 +9,9 @@
 
 #include "logger.h"
 
+#include <algorithm>
+#include <utility>
+
 #include <wal/reader.h>
 
 #include <atomkv/tx.h>
@@ -19,18 +22,35 @@ namespace atomkv{
 
 Logger::Logger(DBImpl* db, std::string_view log_path)
     :  db_(db)
-    , log_path_(log_path)
+    , log_paths_{ std::string(log_path), std::string(log_path) + "2" }
 {
-    writer_.Open(log_path, db_->options()->sync ? tinyio::access_mode::sync_needed : tinyio::access_mode::write);
+    writer_.Open(log_paths_[cur_log_index_], db_->options()->sync ? tinyio::access_mode::sync_needed : tinyio::access_mode::write);
+    OpenSyncFile();
 }
 
 Logger::~Logger() {
-    if (!db_->options()->read_only) {
-        auto tx = db_->Update();
-        Checkpoint();
-        tx.Commit();
-        writer_.Close();
-        std::filesystem::remove(log_path_);
+    if (db_->options()->read_only) {
+        return;
+    }
+    WaitCheckpoint();
+    bool checkpointed = false;
+    if (!checkpoint_failed_) {
+        try {
+            auto tx = db_->Update();
+            Checkpoint();
+            tx.Commit();
+            checkpointed = true;
+        }
+        catch (...) {
+            // The logs are kept, the next open recovers from them
+        }
+    }
+    writer_.Close();
+    sync_file_.close();
+    if (checkpointed) {
+        for (auto& log_path : log_paths_) {
+            std::filesystem::remove(log_path);
+        }
     }
 }
 
@@ -44,33 +64,143 @@ void Logger::AppendLog(const std::span<const uint8_t>* begin, const std::span<co
     }
 }
 
-void Logger::FlushLog() {
-    if (disable_writing_) return;
+uint64_t Logger::FlushLog() {
+    auto& meta = db_->meta();
+    if (disable_writing_) {
+        meta.Publish(meta.meta_struct());
+        return 0;
+    }
     writer_.FlushBuffer();
-    if (db_->options()->sync) {
-        writer_.Sync();
+    auto lock = std::unique_lock(sync_mutex_);
+    flushed_meta_ = meta.meta_struct();
+    if (!db_->options()->sync) {
+        meta.Publish(flushed_meta_);
+    }
+    return ++flushed_lsn_;
+}
+
+void Logger::SyncLog(uint64_t lsn) {
+    if (!db_->options()->sync) return;
+    auto lock = std::unique_lock(sync_mutex_);
+    while (synced_lsn_ < lsn) {
+        if (syncing_) {
+            sync_cond_.wait(lock);
+            continue;
+        }
+        syncing_ = true;
+        const auto sync_lsn = flushed_lsn_;
+        const auto sync_meta = flushed_meta_;
+        lock.unlock();
+        std::exception_ptr exception;
+        try {
+            sync_file_.sync();
+        }
+        catch (...) {
+            exception = std::current_exception();
+        }
+        lock.lock();
+        syncing_ = false;
+        ++sync_count_;
+        if (!exception) {
+            synced_lsn_ = sync_lsn;
+            // Readers only see the commits whose log is durable
+            db_->meta().Publish(sync_meta);
+        }
+        sync_cond_.notify_all();
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+}
+
+uint64_t Logger::sync_count() {
+    auto lock = std::unique_lock(sync_mutex_);
+    return sync_count_;
+}
+
+void Logger::SyncAllLog() {
+    uint64_t lsn;
+    {
+        auto lock = std::unique_lock(sync_mutex_);
+        lsn = flushed_lsn_;
     }
+    SyncLog(lsn);
 }
 
 void Logger::Reset() {
+    SyncAllLog();
     writer_.Close();
-    writer_.Open(log_path_, db_->options()->sync ? tinyio::access_mode::sync_needed : tinyio::access_mode::write);
+    sync_file_.close();
+    std::filesystem::remove(log_paths_[cur_log_index_ ^ 1]);
+    OpenLog(cur_log_index_);
+}
+
+void Logger::OpenLog(uint32_t log_index) {
+    // Start from an empty file
+    std::filesystem::remove(log_paths_[log_index]);
+    cur_log_index_ = log_index;
+    writer_.Open(log_paths_[cur_log_index_], db_->options()->sync ? tinyio::access_mode::sync_needed : tinyio::access_mode::write);
+    OpenSyncFile();
+}
+
+void Logger::OpenSyncFile() {
+    if (db_->options()->sync) {
+        sync_file_.open(log_paths_[cur_log_index_], tinyio::access_mode::sync_needed);
+    }
 }
 
 bool Logger::RecoverNeeded() {
-    return writer_.file().size() > 0;
+    for (auto& log_path : log_paths_) {
+        std::error_code ec;
+        auto size = std::filesystem::file_size(log_path, ec);
+        if (!ec && size > 0) {
+            return true;
+        }
+    }
+    return false;
 }
 
 void Logger::Recover() {
+    // Replay the logs in the order they were written, a log that is still present
+    // after the checkpoint of the other one was interrupted comes first
+    std::vector<std::pair<TxId, const std::string*>> log_list;
+    for (auto& log_path : log_paths_) {
+        wal::Reader reader;
+        reader.Open(log_path);
+        auto record = reader.ReadRecord();
+        if (!record
+            || record->size() < sizeof(WalTxIdLogHeader)
+            || *reinterpret_cast<LogType*>(record->data()) != LogType::kWalTxId) {
+            continue;
+        }
+        auto log = reinterpret_cast<WalTxIdLogHeader*>(record->data());
+        log_list.push_back({ log->txid, &log_path });
+    }
+    std::sort(log_list.begin(), log_list.end());
+
+    auto& meta = db_->meta();
+    auto& tx_manager = db_->tx_manager();
+    const auto raw_txid = meta.meta_struct().txid;
     disable_writing_ = true;
+    for (auto& [_, log_path] : log_list) {
+        RecoverLog(*log_path);
+    }
+    if (meta.meta_struct().txid > raw_txid) {
+        // Persist the recovered transactions together with the free list
+        auto tx = tx_manager.Update();
+        Checkpoint();
+        tx.Commit();
+    }
+    disable_writing_ = false;
+}
+
+void Logger::RecoverLog(const std::string& log_path) {
     wal::Reader reader;
-    reader.Open(log_path_);
+    reader.Open(log_path);
     std::optional<UpdateTx> current_tx;
     bool end = false, init = false;
     auto& meta = db_->meta();
-    auto& pager = db_->pager();
     auto& tx_manager = db_->tx_manager();
-    auto& raw_txid = meta.meta_struct().txid;
     do {
         if (end) {
             break;
@@ -197,24 +327,61 @@ void Logger::Recover() {
             bucket->Delete(key->data(), key->size());
             break;
         }
+        case LogType::kBatch: {
+            if (!init) {
+                throw std::runtime_error("unrecoverable logs.");
+            }
+            assert(record->size() == kBucketBatchLogHeaderSize);
+            auto log = reinterpret_cast<BucketLogHeader*>(record->data());
+            auto& tx = tx_manager.update_tx();
+            BucketImpl* bucket;
+            if (log->bucket_id == kUserRootBucketId) {
+                bucket = &tx.user_bucket();
+            }
+            else {
+                bucket = &tx.AtSubBucket(log->bucket_id);
+            }
+            auto batch = reader.ReadRecord();
+            if (!batch) {
+                end = true;
+                break;
+            }
+            bucket->Write({ reinterpret_cast<const uint8_t*>(batch->data()), batch->size() });
+            break;
+        }
+        case LogType::kDeleteRange: {
+            if (!init) {
+                throw std::runtime_error("unrecoverable logs.");
+            }
+            assert(record->size() == kBucketDeleteRangeLogHeaderSize);
+            auto log = reinterpret_cast<BucketLogHeader*>(record->data());
+            auto& tx = tx_manager.update_tx();
+            BucketImpl* bucket;
+            if (log->bucket_id == kUserRootBucketId) {
+                bucket = &tx.user_bucket();
+            }
+            else {
+                bucket = &tx.AtSubBucket(log->bucket_id);
+            }
+            auto begin = reader.ReadRecord();
+            if (!begin) {
+                end = true;
+                break;
+            }
+            auto end_key = reader.ReadRecord();
+            if (!end_key) {
+                end = true;
+                break;
+            }
+            bucket->DeleteRange(begin->data(), begin->size(), end_key->data(), end_key->size());
+            break;
+        }
         }
     } while (true);
-    disable_writing_ = false;
-    pager.WriteAllDirtyPages();
     if (current_tx.has_value()) {
         // Incomplete log record, discard the last transaction
         current_tx->RollBack();
     }
-    if (meta.meta_struct().txid > raw_txid) {
-        std::error_code ec;
-        db_->db_file_mmap().sync(ec);
-        if (ec) {
-            throw std::system_error(ec, "Failed to sync db file.");
-        }
-        meta.Switch();
-        meta.Save();
-        tx_manager.set_persisted_txid(meta.meta_struct().txid);
-    }
 }
 
 void Logger::Checkpoint() {
@@ -225,7 +392,10 @@ void Logger::Checkpoint() {
         throw std::runtime_error("Checkpoint can only be invoked within a write transaction.");
     }
 
+    WaitCheckpoint();
+
     pager.SaveFreeList();
+    meta.Reset(tx_manager.update_tx().meta_struct());
     pager.WriteAllDirtyPages();
 
     meta.Switch();
@@ -240,6 +410,82 @@ void Logger::Checkpoint() {
     if (checkpoint_needed_) checkpoint_needed_ = false;
 }
 
+void Logger::AsyncCheckpoint() {
+    auto& meta = db_->meta();
+    auto& pager = db_->pager();
+    auto& tx_manager = db_->tx_manager();
+    if (!tx_manager.has_update_tx()) {
+        throw std::runtime_error("Checkpoint can only be invoked within a write transaction.");
+    }
+
+    if (checkpoint_running_) {
+        // The previous checkpoint is still in progress, retry on a later commit
+        return;
+    }
+    if (checkpoint_failed_) {
+        // Switching logs would truncate the one the failed checkpoint did not cover
+        return;
+    }
+    WaitCheckpoint();
+
+    // Writers continue in the other log, this one is no longer needed after the checkpoint.
+    // Synced first, so the commit is durable before the reset publishes it.
+    SyncAllLog();
+
+    pager.SaveFreeList();
+    meta.Reset(tx_manager.update_tx().meta_struct());
+
+    // Freed pages are not reused until a later version is persisted,
+    // so the pages of this version stay intact until it is saved.
+    const MetaStruct meta_struct = meta.meta_struct();
+
+    writer_.Close();
+    sync_file_.close();
+    std::string old_log_path = log_paths_[cur_log_index_];
+    OpenLog(cur_log_index_ ^ 1);
+    AppendWalTxIdLog();
+    checkpoint_needed_ = false;
+
+    checkpoint_running_ = true;
+    checkpoint_thread_ = std::thread([this, meta_struct, old_log_path = std::move(old_log_path)]() {
+        try {
+            db_->pager().WriteAllDirtyPages();
+
+            auto& meta = db_->meta();
+            meta.Switch();
+            meta.Save(meta_struct);
+
+            db_->tx_manager().set_persisted_txid(meta_struct.txid);
+
+            std::filesystem::remove(old_log_path);
+        }
+        catch (...) {
+            // Both logs are still needed for recovery, no further checkpoint is started
+            // and write transactions are refused from now on
+            checkpoint_exception_ = std::current_exception();
+            checkpoint_failed_.store(true, std::memory_order_release);
+        }
+        checkpoint_running_ = false;
+    });
+}
+
+void Logger::WaitCheckpoint() {
+    if (!checkpoint_thread_.joinable()) {
+        return;
+    }
+    checkpoint_thread_.join();
+}
+
+void Logger::ThrowCheckpointError() const {
+    assert(checkpoint_failed_);
+    try {
+        std::rethrow_exception(checkpoint_exception_);
+    }
+    catch (...) {
+        std::throw_with_nested(std::runtime_error("The background checkpoint failed, the database no longer accepts write transactions."));
+    }
+}
+
 void Logger::AppendWalTxIdLog() {
     WalTxIdLogHeader log;
     log.type = LogType::kWalTxId;
@@ -9,9 +9,18 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include <wal/tinyio.hpp>
 #include <wal/writer.h>
 
 #include <atomkv/noncopyable.h>
+#include <atomkv/meta_format.h>
 
 #include "log_type.h"
 
@@ -26,23 +35,58 @@ public:
 
     void AppendLog(const std::span<const uint8_t>* begin, const std::span<const uint8_t>* end);
     void AppendWalTxIdLog();
-    void FlushLog();
+    // Returns the sequence number of this flush, to be passed to SyncLog.
+    // The committed meta is published to readers once the log is synced, right away without sync.
+    uint64_t FlushLog();
+    void SyncLog(uint64_t lsn);
+    uint64_t sync_count();
 
     void Reset();
     bool CheckPointNeeded() const { return checkpoint_needed_; }
     void Checkpoint();
+    void AsyncCheckpoint();
+    // Wait until the background checkpoint is done, its error is reported by checkpoint_failed
+    void WaitCheckpoint();
+    // After a background checkpoint failed, write transactions are refused
+    bool checkpoint_failed() const { return checkpoint_failed_.load(std::memory_order_acquire); }
+    [[noreturn]] void ThrowCheckpointError() const;
     bool RecoverNeeded();
     void Recover();
 
+private:
+    void OpenLog(uint32_t log_index);
+    void OpenSyncFile();
+    void SyncAllLog();
+    void RecoverLog(const std::string& log_path);
 
 private:
     DBImpl* const db_;
 
-    const std::string log_path_;
+    // Logging alternates between two files, so that writers can continue
+    // in one while the other is being checkpointed in the background.
+    const std::array<std::string, 2> log_paths_;
+    uint32_t cur_log_index_ = 0;
     wal::Writer writer_;
     bool disable_writing_{ false };
 
     bool checkpoint_needed_{ false };
+    std::thread checkpoint_thread_;
+    std::atomic<bool> checkpoint_running_{ false };
+    std::exception_ptr checkpoint_exception_;
+    std::atomic<bool> checkpoint_failed_{ false };
+
+    // Group commit, the writer that finds no sync in progress becomes the leader,
+    // and its sync covers every log flushed before it started.
+    // The leader syncs through its own handle, the next writer keeps appending to writer_.
+    tinyio::file sync_file_;
+    std::mutex sync_mutex_;
+    std::condition_variable sync_cond_;
+    bool syncing_{ false };
+    uint64_t flushed_lsn_{ 0 };
+    uint64_t synced_lsn_{ 0 };
+    // The meta of the last flushed commit, published by the sync that covers it
+    MetaStruct flushed_meta_{};
+    uint64_t sync_count_{ 0 };
 };
 
 } // namespace atomkv
\ No newline at end of file
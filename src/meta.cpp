@@ -17,9 +17,47 @@
 
 namespace atomkv {
 
-Meta::Meta(DBImpl* db, MetaStruct* meta_struct)
+namespace {
+
+// Reads the meta saved in a meta page into the current layout,
+// returns false if it is incomplete
+bool ReadMetaStruct(const uint8_t* ptr, MetaStruct* meta_struct) {
+    wal::Crc32 crc32;
+    if (reinterpret_cast<const MetaStruct*>(ptr)->min_version < kMetaMinVersion) {
+        MetaStructV1 old_struct;
+        std::memcpy(&old_struct, ptr, kMetaV1Size);
+        crc32.Append(&old_struct, kMetaV1Size - sizeof(uint32_t));
+        if (crc32.End() != old_struct.crc32) {
+            return false;
+        }
+        // The free list layout is unchanged, it only has no delta blocks yet
+        meta_struct->sign = old_struct.sign;
+        meta_struct->page_size = old_struct.page_size;
+        meta_struct->min_version = kMetaMinVersion;
+        meta_struct->flags = 0;
+        meta_struct->page_count = old_struct.page_count;
+        meta_struct->user_root = old_struct.user_root;
+        meta_struct->free_list_pgid = old_struct.free_list_pgid;
+        meta_struct->free_pair_count = old_struct.free_pair_count;
+        meta_struct->free_list_page_count = old_struct.free_list_page_count;
+        meta_struct->free_delta_pgid = kPageInvalidId;
+        meta_struct->free_delta_count = 0;
+        meta_struct->txid = old_struct.txid;
+        meta_struct->crc32 = 0;
+        return true;
+    }
+    std::memcpy(meta_struct, ptr, kMetaSize);
+    crc32.Append(meta_struct, kMetaSize - sizeof(uint32_t));
+    return crc32.End() == meta_struct->crc32;
+}
+
+} // namespace
+
+Meta::Meta(DBImpl* db, MetaStruct* meta_struct, MetaStruct* view_meta_struct, std::atomic<uint64_t>* sequence)
     : db_(db)
-    , meta_struct_(meta_struct) {}
+    , meta_struct_(meta_struct)
+    , view_meta_struct_(view_meta_struct)
+    , sequence_(sequence) {}
 
 Meta::~Meta() = default;
 
@@ -29,79 +67,96 @@ void Meta::Init() {
     auto const first = meta_struct_;
     first->sign = ATOMKV_SIGN;
     first->page_size = db_->options()->page_size;
-    first->min_version = ATOMKV_VERSION;
+    first->min_version = kMetaMinVersion;
+    first->flags = 0;
+    if (db_->options()->key_prefix) {
+        first->flags |= kMetaFlagKeyPrefix;
+    }
+    if (db_->options()->prefix_compression) {
+        first->flags |= kMetaFlagPrefixCompression;
+    }
     first->page_count = 2;
-    first->txid = 2;
+    first->txid = 1;
     first->user_root = kPageInvalidId;
     first->free_list_pgid = kPageInvalidId;
     first->free_pair_count = 0;
     first->free_list_page_count = 0;
+    first->free_delta_pgid = kPageInvalidId;
+    first->free_delta_count = 0;
     Save();
 
+    // The current meta must carry the highest txid,
+    // otherwise the first commit ties with the stale one and is lost on reopen
     Switch();
-    first->txid = 1;
+    first->txid = 2;
     Save();
-
-    Switch();
+    std::memcpy(view_meta_struct_, meta_struct_, kMetaSize);
 }
 
 void Meta::Load() {
     auto ptr = db_->db_file_mmap().data();
 
     // Verify available metadata
-    auto first = reinterpret_cast<MetaStruct*>(ptr);
-    auto second = reinterpret_cast<MetaStruct*>(ptr + db_->options()->page_size);
+    auto data = reinterpret_cast<const uint8_t*>(ptr);
+    const uint8_t* pages[2] = { data, data + db_->options()->page_size };
+    auto first = reinterpret_cast<const MetaStruct*>(pages[0]);
+    auto second = reinterpret_cast<const MetaStruct*>(pages[1]);
 
     if (first->sign != ATOMKV_SIGN && second->sign != ATOMKV_SIGN) {
         throw std::runtime_error("Not a atomkv file.");
     }
-    if (ATOMKV_VERSION < first->min_version) {
-        throw std::runtime_error("the target database version is too high.");
+
+    // Verify if the metadata is complete, the layout of each one depends on the version that saved it
+    MetaStruct metas[2];
+    bool valid[2];
+    for (uint32_t i = 0; i < 2; ++i) {
+        auto header = reinterpret_cast<const MetaStruct*>(pages[i]);
+        if (header->sign != ATOMKV_SIGN) {
+            valid[i] = false;
+            continue;
+        }
+        if (ATOMKV_VERSION < header->min_version) {
+            throw std::runtime_error("the target database version is too high.");
+        }
+        valid[i] = ReadMetaStruct(pages[i], &metas[i]);
+    }
+    if (!valid[0] && !valid[1]) {
+        throw std::runtime_error("database is damaged.");
     }
 
-    const MetaStruct* select;
     // Prioritize selecting the new version
-    cur_meta_index_ = 0;
-    if (first->txid < second->txid) {
-        cur_meta_index_ = 1;
-        select = second;
+    if (valid[0] && valid[1]) {
+        cur_meta_index_ = metas[0].txid < metas[1].txid ? 1 : 0;
     } else {
-        select = first;
+        cur_meta_index_ = valid[0] ? 0 : 1;
     }
+    const MetaStruct& select = metas[cur_meta_index_];
 
-    //Verify if the metadata is complete. If it is incomplete, use another one
-    wal::Crc32 crc32;
-    crc32.Append(select, kMetaSize - sizeof(uint32_t));
-    auto crc32_value = crc32.End();
-    if (crc32_value != select->crc32) {
-        if (cur_meta_index_ == 1) {
-            cur_meta_index_ = 0;
-            select = first;
-        } else {
-            cur_meta_index_ = 1;
-            select = second;
-        }
-        crc32.Append(select, kMetaSize - sizeof(uint32_t));
-        crc32_value = crc32.End();
-        if (crc32_value != select->crc32) {
-            throw std::runtime_error("database is damaged.");
-        }
+    // A flag this version does not know changes a format it cannot read
+    if (select.flags & ~kMetaFlagMask) {
+        throw std::runtime_error("the database uses a format this version does not support.");
     }
 
     // Page size requirements are consistent
-    if (select->page_size != db_->options()->page_size) {
+    if (select.page_size != db_->options()->page_size) {
         throw std::runtime_error("database cannot match system page size.");
     }
 
-    std::memcpy(meta_struct_, select, kMetaSize);
+    std::memcpy(meta_struct_, &select, kMetaSize);
+    std::memcpy(view_meta_struct_, &select, kMetaSize);
 }
 
 void Meta::Save() {
+    Save(*meta_struct_);
+}
+
+void Meta::Save(const MetaStruct& meta_struct) {
+    MetaStruct save_struct = meta_struct;
     wal::Crc32 crc32;
-    crc32.Append(meta_struct_, kMetaSize - sizeof(uint32_t));
-    meta_struct_->crc32 = crc32.End();
-    db_->db_file().seekg(cur_meta_index_ * meta_struct_->page_size);
-    db_->db_file().write(meta_struct_, kMetaSize);
+    crc32.Append(&save_struct, kMetaSize - sizeof(uint32_t));
+    save_struct.crc32 = crc32.End();
+    db_->db_file().seekg(cur_meta_index_ * save_struct.page_size);
+    db_->db_file().write(&save_struct, kMetaSize);
     db_->db_file().sync();
 }
 
@@ -111,6 +166,36 @@ void Meta::Switch() {
 
 void Meta::Reset(const MetaStruct& meta_struct) {
     CopyMetaInfo(meta_struct_, meta_struct);
+    Publish(meta_struct);
+}
+
+void Meta::Publish(const MetaStruct& meta_struct) {
+    auto lock = std::unique_lock(publish_mutex_);
+    if (meta_struct.txid < view_meta_struct_->txid) {
+        return;
+    }
+    const auto sequence = sequence_->load(std::memory_order_relaxed);
+    sequence_->store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    CopyMetaInfo(view_meta_struct_, meta_struct);
+    // seq_cst, the slot scan of the next writer must be ordered after it, see TxManager::PublishView
+    sequence_->store(sequence + 2, std::memory_order_seq_cst);
+}
+
+MetaStruct Meta::Snapshot(uint64_t* sequence) const {
+    MetaStruct snapshot;
+    while (true) {
+        const auto begin = sequence_->load(std::memory_order_acquire);
+        if (begin & 1) {
+            continue;
+        }
+        std::memcpy(&snapshot, view_meta_struct_, kMetaSize);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence_->load(std::memory_order_relaxed) == begin) {
+            *sequence = begin;
+            return snapshot;
+        }
+    }
 }
 
 } // namespace atomkv
\ No newline at end of file
@@ -11,6 +11,9 @@
 
 #include <cstdint>
 
+#include <atomic>
+#include <mutex>
+
 #include <atomkv/noncopyable.h>
 #include <atomkv/meta_format.h>
 
@@ -20,14 +23,22 @@ class DBImpl;
 
 class Meta : noncopyable {
 public:
-    Meta(DBImpl* db, MetaStruct* meta_struct);
+    Meta(DBImpl* db, MetaStruct* meta_struct, MetaStruct* view_meta_struct, std::atomic<uint64_t>* sequence);
     ~Meta();
 
     void Init();
     void Load();
     void Save();
+    void Save(const MetaStruct& meta_struct);
     void Switch();
+    // Takes the meta of a commit for the next writer and publishes it to readers, only called by the writer
     void Reset(const MetaStruct& meta_struct);
+    // Publishes the meta of a commit to readers, an older one than the published meta is ignored
+    void Publish(const MetaStruct& meta_struct);
+    // Copies the published meta without locking, retrying while a commit is publishing it
+    MetaStruct Snapshot(uint64_t* sequence) const;
+
+    uint64_t sequence() const { return sequence_->load(std::memory_order_seq_cst); }
 
     const auto& meta_struct() const { return *meta_struct_; }
     auto& meta_struct() { return *meta_struct_; }
@@ -35,6 +46,11 @@ public:
 private:
     DBImpl* const db_;
     MetaStruct* meta_struct_;
+    // In kWal it lags meta_struct_ until the log of the commit is synced
+    MetaStruct* const view_meta_struct_;
+    std::atomic<uint64_t>* const sequence_;
+    // The writer and the leader of a group commit may both publish
+    std::mutex publish_mutex_;
     uint32_t cur_meta_index_ = 0;
 };
 
@@ -9,6 +9,15 @@
 
 #include <atomkv/node.h>
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
 #include <atomkv/bucket_impl.h>
 #include <atomkv/tx.h>
 
@@ -16,6 +25,54 @@
 
 namespace atomkv {
 
+static Node::KeyPrefix LoadKeyPrefix(const uint8_t* prefixes, size_t index) {
+    Node::KeyPrefix prefix;
+    std::memcpy(&prefix, prefixes + index * sizeof(prefix), sizeof(prefix));
+    return prefix;
+}
+
+// Counts the sorted prefixes that are less than the value
+static size_t CountLessKeyPrefix(const uint8_t* prefixes, size_t count, Node::KeyPrefix value) {
+    // Binary search down to a window that is cheaper to compare entirely
+    size_t first = 0, last = count;
+    while (last - first > 32) {
+        const size_t mid = first + (last - first) / 2;
+        if (LoadKeyPrefix(prefixes, mid) < value) {
+            first = mid + 1;
+        } else {
+            last = mid;
+        }
+    }
+
+    size_t less = first;
+    size_t i = first;
+    // There is no unsigned compare, flipping the sign bit keeps the order for signed compares
+#if defined(__AVX2__)
+    const __m256i sign_256 = _mm256_set1_epi32(INT32_MIN);
+    const __m256i value_256 = _mm256_xor_si256(_mm256_set1_epi32(static_cast<int32_t>(value)), sign_256);
+    for (; i + 8 <= last; i += 8) {
+        auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prefixes + i * sizeof(value)));
+        v = _mm256_xor_si256(v, sign_256);
+        const auto mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(value_256, v)));
+        less += std::popcount(static_cast<uint32_t>(mask));
+    }
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+    const __m128i sign_128 = _mm_set1_epi32(INT32_MIN);
+    const __m128i value_128 = _mm_xor_si128(_mm_set1_epi32(static_cast<int32_t>(value)), sign_128);
+    for (; i + 4 <= last; i += 4) {
+        auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prefixes + i * sizeof(value)));
+        v = _mm_xor_si128(v, sign_128);
+        const auto mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(value_128, v)));
+        less += std::popcount(static_cast<uint32_t>(mask));
+    }
+#endif
+    for (; i < last; ++i) {
+        less += LoadKeyPrefix(prefixes, i) < value;
+    }
+    return less;
+}
+
 Node::Node(BTree* btree, PageId page_id, bool dirty)
     : btree_(btree)
     , page_(btree_->bucket().pager().Reference(page_id, dirty))
@@ -35,12 +92,14 @@ Node::~Node() = default;
 Node::Node(Node&& right) noexcept
     : btree_(right.btree_)
     , page_(std::move(right.page_))
-    , data_(page_->get<NodeData>()) {}
+    , data_(page_->get<NodeData>())
+    , key_buf_(std::move(right.key_buf_)) {}
 
 void Node::operator=(Node&& right) noexcept {
     assert(btree_ == right.btree_);
     page_ = std::move(right.page_);
     data_ = page_->get<NodeData>();
+    key_buf_ = std::move(right.key_buf_);
 }
 
 bool Node::IsLeaf() const {
@@ -54,23 +113,185 @@ bool Node::IsBranch() const {
 std::span<const uint8_t> Node::GetKey(SlotId slot_id) {
     assert(slot_id < count());
     auto& slot = data_->slots[slot_id];
-    return { GetRecordPtr(slot_id), slot.key_size };
+    std::span<const uint8_t> key{ GetRecordPtr(slot_id), slot.key_size };
+    if (slot.is_overflow_pages) {
+        // Overflow pages keep the full key
+        return key;
+    }
+    auto node_prefix = GetNodePrefix();
+    if (node_prefix.empty()) {
+        return key;
+    }
+    key_buf_.assign(node_prefix.begin(), node_prefix.end());
+    key_buf_.insert(key_buf_.end(), key.begin(), key.end());
+    return key_buf_;
+}
+
+std::span<const uint8_t> Node::GetKey(SlotId slot_id, std::vector<uint8_t>* key_buf) {
+    assert(slot_id < count());
+    auto& slot = data_->slots[slot_id];
+    std::span<const uint8_t> key{ GetRecordPtr(slot_id), slot.key_size };
+    if (slot.is_overflow_pages) {
+        return key;
+    }
+    auto node_prefix = GetNodePrefix();
+    if (node_prefix.empty()) {
+        return key;
+    }
+    if (key_buf->size() != node_prefix.size() + key.size()
+        || !std::equal(node_prefix.begin(), node_prefix.end(), key_buf->begin())
+        || !std::equal(key.begin(), key.end(), key_buf->begin() + node_prefix.size())) {
+        key_buf->assign(node_prefix.begin(), node_prefix.end());
+        key_buf->insert(key_buf->end(), key.begin(), key.end());
+    }
+    return *key_buf;
+}
+
+// The built-in comparators as function objects, so that the search can inline them
+struct ByteArrayCompare {
+    std::strong_ordering operator()(std::span<const uint8_t> key1, std::span<const uint8_t> key2) const {
+        return ByteArrayCompFunc(key1, key2);
+    }
+};
+
+template <class IntT, bool kBigEndian>
+struct IntegerCompare {
+    static IntT Load(std::span<const uint8_t> key) {
+        assert(key.size() == sizeof(IntT));
+        IntT value;
+        if constexpr (kBigEndian) {
+            value = 0;
+            for (size_t i = 0; i < sizeof(IntT); ++i) {
+                value = value << 8 | key[i];
+            }
+        } else {
+            std::memcpy(&value, key.data(), sizeof(IntT));
+        }
+        return value;
+    }
+
+    std::strong_ordering operator()(std::span<const uint8_t> key1, std::span<const uint8_t> key2) const {
+        return Load(key1) <=> Load(key2);
+    }
+};
+
+struct FuncPtrCompare {
+    Comparator::FuncPtr ptr;
+
+    std::strong_ordering operator()(std::span<const uint8_t> key1, std::span<const uint8_t> key2) const {
+        return ptr(key1, key2);
+    }
+};
+
+template <class Compare>
+static std::pair<SlotId, bool> LowerBoundWith(Node* node, std::span<const uint8_t> key) {
+    return node->LowerBound(key, Compare{});
+}
+
+Node::LowerBoundFunc Node::SelectLowerBound(Comparator comparator) {
+    if (comparator.ptr_ == ByteArrayCompFunc) {
+        return LowerBoundWith<ByteArrayCompare>;
+    }
+    if (comparator.ptr_ == UInt32CompFunc) {
+        return LowerBoundWith<IntegerCompare<uint32_t, false>>;
+    }
+    if (comparator.ptr_ == UInt64CompFunc) {
+        return LowerBoundWith<IntegerCompare<uint64_t, false>>;
+    }
+    if (comparator.ptr_ == UInt32BigEndianCompFunc) {
+        return LowerBoundWith<IntegerCompare<uint32_t, true>>;
+    }
+    if (comparator.ptr_ == UInt64BigEndianCompFunc) {
+        return LowerBoundWith<IntegerCompare<uint64_t, true>>;
+    }
+    return [](Node* node, std::span<const uint8_t> key) {
+        return node->LowerBound(key, FuncPtrCompare{ node->btree_->comparator() });
+    };
 }
 
 std::pair<SlotId, bool> Node::LowerBound(std::span<const uint8_t> key) {
+    return btree_->lower_bound_func()(this, key);
+}
+
+template <class Compare>
+std::pair<SlotId, bool> Node::LowerBound(std::span<const uint8_t> key, Compare compare) {
+    SlotId first = 0, last = count();
+    if (btree_->prefix_search()) {
+        // Only the keys with the same prefix need to be compared
+        std::tie(first, last) = KeyPrefixEqualRange(MakeKeyPrefix(key));
+        if (first == last) {
+            return { first, false };
+        }
+    }
+
     bool eq = false;
-    auto pos = std::lower_bound(data_->slots, data_->slots + count(), key
-        , [&](const Slot& slot, std::span<const uint8_t> search_key) -> bool
-    {
-        auto diff = &slot - data_->slots;
-        SlotId slot_id = diff;
-        auto slot_key = GetKey(slot_id);
-        auto res = btree_->comparator()(slot_key, search_key);
-        if (res == std::strong_ordering::equal) eq = true;
-        return res == std::strong_ordering::less;
-    });
-    auto diff = pos - data_->slots;
-    return { diff, eq };
+    auto search = [&](std::span<const uint8_t> search_key, auto&& get_key, auto&& compare) -> std::pair<SlotId, bool> {
+        auto pos = std::lower_bound(data_->slots + first, data_->slots + last, search_key
+            , [&](const Slot& slot, std::span<const uint8_t> search_key) -> bool
+        {
+            auto diff = &slot - data_->slots;
+            SlotId slot_id = diff;
+            auto slot_key = get_key(slot_id);
+            auto res = compare(slot_key, search_key);
+            if (res == std::strong_ordering::equal) eq = true;
+            return res == std::strong_ordering::less;
+        });
+        auto diff = pos - data_->slots;
+        return { diff, eq };
+    };
+
+    auto node_prefix = GetNodePrefix();
+    if (!node_prefix.empty() && btree_->byte_order()) {
+        // All keys start with the node prefix, only the suffixes need to be compared
+        const size_t head_size = std::min(key.size(), node_prefix.size());
+        const auto res = std::memcmp(key.data(), node_prefix.data(), head_size);
+        if (res < 0 || (res == 0 && key.size() < node_prefix.size())) {
+            return { 0, false };
+        }
+        if (res > 0) {
+            return { count(), false };
+        }
+        return search(key.subspan(node_prefix.size()),
+            [&](SlotId slot_id) { return GetKeySuffix(slot_id); }, ByteArrayCompare{});
+    }
+    return search(key, [&](SlotId slot_id) { return GetKey(slot_id); }, compare);
+}
+
+Node::KeyPrefix Node::MakeKeyPrefix(std::span<const uint8_t> key) {
+    KeyPrefix prefix = 0;
+    const size_t size = std::min(key.size(), sizeof(KeyPrefix));
+    for (size_t i = 0; i < size; ++i) {
+        prefix |= static_cast<KeyPrefix>(key[i]) << ((sizeof(KeyPrefix) - 1 - i) * 8);
+    }
+    return prefix;
+}
+
+Node::KeyPrefix Node::GetKeyPrefix(SlotId slot_id) {
+    assert(btree_->key_prefix());
+    assert(slot_id < count());
+    return LoadKeyPrefix(KeyPrefixPtr(), slot_id);
+}
+
+std::span<const uint8_t> Node::GetNodePrefix() {
+    if (!btree_->prefix_compression()) {
+        return {};
+    }
+    NodePrefixSize prefix_size;
+    const auto size_ptr = Ptr() + page_size() - sizeof(prefix_size);
+    std::memcpy(&prefix_size, size_ptr, sizeof(prefix_size));
+    assert(prefix_size <= kNodePrefixMaxSize);
+    return { size_ptr - prefix_size, prefix_size };
+}
+
+void Node::ReverseSlots() {
+    std::reverse(data_->slots, data_->slots + count());
+    if (btree_->key_prefix()) {
+        for (SlotId i = 0, j = count() - 1; i < j; ++i, --j) {
+            const auto prefix = GetKeyPrefix(i);
+            SetKeyPrefix(i, GetKeyPrefix(j));
+            SetKeyPrefix(j, prefix);
+        }
+    }
 }
 
 double Node::GetFillRate() {
@@ -122,28 +343,200 @@ PageSize Node::MaxInlineRecordSize() {
     PageSize max_size = page_size() -
         sizeof(NodeData::header) -
         sizeof(NodeData::padding);
-    // Ensure that each node can store at least two records
-    max_size -= sizeof(Slot) * 2;
+    // Ensure that each node can store at least two records.
+    // The node prefix is shared by both records, its bytes are counted in their full keys.
+    max_size -= SlotSize() * 2;
+    if (btree_->prefix_compression()) {
+        max_size -= sizeof(NodePrefixSize);
+    }
     assert(max_size % 2 == 0);
     return max_size / 2;
 }
 
+PageSize Node::SlotSize() const {
+    if (btree_->key_prefix()) {
+        return sizeof(Slot) + sizeof(KeyPrefix);
+    }
+    return sizeof(Slot);
+}
+
+uint8_t* Node::KeyPrefixPtr() {
+    return reinterpret_cast<uint8_t*>(data_->slots + count());
+}
+
+void Node::SetKeyPrefix(SlotId slot_id, KeyPrefix prefix) {
+    assert(btree_->key_prefix());
+    assert(slot_id < count());
+    std::memcpy(KeyPrefixPtr() + slot_id * sizeof(prefix), &prefix, sizeof(prefix));
+}
+
+std::pair<SlotId, SlotId> Node::KeyPrefixEqualRange(KeyPrefix prefix) {
+    const auto prefixes = KeyPrefixPtr();
+    const SlotId first = CountLessKeyPrefix(prefixes, count(), prefix);
+    if (prefix == std::numeric_limits<KeyPrefix>::max()) {
+        return { first, count() };
+    }
+    // Only the slots from first on can be equal
+    const SlotId last = first + CountLessKeyPrefix(prefixes + first * sizeof(prefix), count() - first, prefix + 1);
+    return { first, last };
+}
+
+PageSize Node::TrailerSize() {
+    if (!btree_->prefix_compression()) {
+        return 0;
+    }
+    return sizeof(NodePrefixSize) + GetNodePrefix().size();
+}
+
+void Node::InitTrailer() {
+    if (btree_->prefix_compression()) {
+        const NodePrefixSize prefix_size = 0;
+        std::memcpy(Ptr() + page_size() - sizeof(prefix_size), &prefix_size, sizeof(prefix_size));
+    }
+    data_->header.data_offset = page_size() - TrailerSize();
+}
+
+std::span<const uint8_t> Node::GetKeySuffix(SlotId slot_id) {
+    auto& slot = data_->slots[slot_id];
+    std::span<const uint8_t> key{ GetRecordPtr(slot_id), slot.key_size };
+    if (slot.is_overflow_pages) {
+        return key.subspan(GetNodePrefix().size());
+    }
+    return key;
+}
+
+void Node::SetNodePrefix(std::span<const uint8_t> prefix) {
+    assert(count() == 0 && data_->header.space_used == 0);
+    assert(prefix.size() <= kNodePrefixMaxSize);
+    const NodePrefixSize prefix_size = prefix.size();
+    const auto size_ptr = Ptr() + page_size() - sizeof(prefix_size);
+    std::memcpy(size_ptr - prefix_size, prefix.data(), prefix_size);
+    std::memcpy(size_ptr, &prefix_size, sizeof(prefix_size));
+    data_->header.data_offset = page_size() - TrailerSize();
+}
+
+void Node::NarrowNodePrefix(size_t prefix_size, SlotId replaced_slot_id) {
+    auto old_prefix = GetNodePrefix();
+    assert(prefix_size < old_prefix.size());
+    std::array<uint8_t, kNodePrefixMaxSize> saved_prefix;
+    std::memcpy(saved_prefix.data(), old_prefix.data(), old_prefix.size());
+    const size_t moved_size = old_prefix.size() - prefix_size;
+
+    // Rebuild the records in the temporary page like Compactify, with the moved bytes in front of the keys
+    auto& tmp_page = btree_->bucket().pager().tmp_page();
+    const PageOffset trailer_offset = page_size() - sizeof(NodePrefixSize) - prefix_size;
+    PageOffset offset = trailer_offset;
+    PageSize space_used = 0;
+    for (SlotId i = 0; i < count(); ++i) {
+        if (i == replaced_slot_id) {
+            continue;
+        }
+        auto& slot = data_->slots[i];
+        size_t size;
+        if (slot.is_overflow_pages) {
+            size = sizeof(OverflowRecord);
+            offset -= size;
+            std::memcpy(tmp_page + offset, GetRawRecordPtr(i), size);
+        }
+        else {
+            size = slot.key_size;
+            if (IsLeaf()) {
+                size += slot.value_size;
+            }
+            offset -= size + moved_size;
+            std::memcpy(tmp_page + offset, saved_prefix.data() + prefix_size, moved_size);
+            std::memcpy(tmp_page + offset + moved_size, GetRawRecordPtr(i), size);
+            slot.key_size += moved_size;
+            size += moved_size;
+        }
+        slot.record_offset = offset;
+        space_used += size;
+    }
+
+    std::memcpy(Ptr() + offset, tmp_page + offset, trailer_offset - offset);
+    const NodePrefixSize new_prefix_size = prefix_size;
+    std::memcpy(Ptr() + trailer_offset, saved_prefix.data(), prefix_size);
+    std::memcpy(Ptr() + trailer_offset + prefix_size, &new_prefix_size, sizeof(new_prefix_size));
+    data_->header.data_offset = offset;
+    data_->header.space_used = space_used;
+}
+
+void Node::InsertSlot(SlotId slot_id) {
+    assert(slot_id <= count());
+    assert(FreeSpace() >= SlotSize());
+    if (btree_->key_prefix()) {
+        // The prefix array starts after the new slot, move the prefixes after slot_id first
+        const auto old_prefixes = KeyPrefixPtr();
+        const auto new_prefixes = old_prefixes + sizeof(Slot);
+        std::memmove(new_prefixes + (slot_id + 1) * sizeof(KeyPrefix), old_prefixes + slot_id * sizeof(KeyPrefix),
+            sizeof(KeyPrefix) * (count() - slot_id));
+        std::memmove(new_prefixes, old_prefixes, sizeof(KeyPrefix) * slot_id);
+    }
+    std::memmove(data_->slots + slot_id + 1, data_->slots + slot_id,
+        sizeof(Slot) * (count() - slot_id));
+    ++data_->header.count;
+}
+
+void Node::EraseSlot(SlotId slot_id) {
+    assert(slot_id < count());
+    std::memmove(data_->slots + slot_id, data_->slots + slot_id + 1,
+        sizeof(Slot) * (count() - slot_id - 1));
+    if (btree_->key_prefix()) {
+        const auto old_prefixes = KeyPrefixPtr();
+        const auto new_prefixes = old_prefixes - sizeof(Slot);
+        std::memmove(new_prefixes, old_prefixes, sizeof(KeyPrefix) * slot_id);
+        std::memmove(new_prefixes + slot_id * sizeof(KeyPrefix), old_prefixes + (slot_id + 1) * sizeof(KeyPrefix),
+            sizeof(KeyPrefix) * (count() - slot_id - 1));
+    }
+    --data_->header.count;
+}
+
 size_t Node::SpaceNeeded(size_t record_size, bool slot_needed) {
     if (!slot_needed) {
         return record_size;
     }
-    return record_size + sizeof(Slot);
+    return record_size + SlotSize();
 }
 
-bool Node::RequestSpaceFor(std::span<const uint8_t> key, std::span<const uint8_t> value, bool slot_needed) {
+bool Node::RequestSpaceFor(std::span<const uint8_t> key, std::span<const uint8_t> value, bool slot_needed, SlotId replaced_slot_id) {
     auto size = key.size() + value.size();
 
+    // The node prefix may have to narrow to fit the key, moving bytes into the other records
+    size_t prefix_size = 0;
+    size_t moved_size = 0;
+    size_t moved_count = 0;
+    if (btree_->prefix_compression()) {
+        if (count() == 0) {
+            SetNodePrefix(key.first(std::min(key.size(), kNodePrefixMaxSize)));
+        }
+        auto node_prefix = GetNodePrefix();
+        prefix_size = std::mismatch(node_prefix.begin(), node_prefix.end(), key.begin(), key.end()).first - node_prefix.begin();
+        moved_size = node_prefix.size() - prefix_size;
+        if (moved_size > 0) {
+            for (SlotId i = 0; i < count(); ++i) {
+                if (i != replaced_slot_id && !data_->slots[i].is_overflow_pages) {
+                    ++moved_count;
+                }
+            }
+        }
+    }
+
     size_t space_needed;
     if (size > MaxInlineRecordSize()) {
         space_needed = SpaceNeeded(sizeof(OverflowRecord), slot_needed);
     }
     else {
-        space_needed = SpaceNeeded(size, slot_needed);
+        space_needed = SpaceNeeded(size - prefix_size, slot_needed);
+    }
+
+    if (moved_size > 0) {
+        // The trailer shrinks by the moved bytes
+        space_needed += moved_size * moved_count;
+        if (space_needed > FreeSpaceAfterCompaction() + moved_size) {
+            return false;
+        }
+        NarrowNodePrefix(prefix_size, replaced_slot_id);
+        return true;
     }
 
     if (space_needed <= FreeSpace()) {
@@ -159,7 +552,7 @@ bool Node::RequestSpaceFor(std::span<const uint8_t> key, std::span<const uint8_t
 }
 
 PageSize Node::SlotSpace() {
-    auto slot_space = reinterpret_cast<const uint8_t*>(data_->slots + data_->header.count) - Ptr();
+    auto slot_space = reinterpret_cast<const uint8_t*>(data_->slots) - Ptr() + SlotSize() * data_->header.count;
     assert(slot_space < page_size());
     return slot_space;
 }
@@ -172,8 +565,8 @@ PageSize Node::FreeSpace() {
 }
 
 PageSize Node::FreeSpaceAfterCompaction() {
-    assert(page_size() >= SlotSpace() + data_->header.space_used);
-    PageSize free_space = page_size() - SlotSpace() - data_->header.space_used;
+    assert(page_size() >= SlotSpace() + data_->header.space_used + TrailerSize());
+    PageSize free_space = page_size() - SlotSpace() - data_->header.space_used - TrailerSize();
     assert(free_space < page_size());
     return free_space;
 }
@@ -185,7 +578,7 @@ void Node::Compactify() {
     auto tmp_node = Node(btree_, tmp_page);
     std::memset(&tmp_node.data_->header, 0, sizeof(tmp_node.data_->header));
 
-    tmp_node.data_->header.data_offset = pager.page_size();
+    tmp_node.data_->header.data_offset = pager.page_size() - TrailerSize();
 
     CopyRecordRange(&tmp_node);
     assert(data_->header.space_used == tmp_node.data_->header.space_used);
@@ -200,6 +593,22 @@ uint8_t* Node::Ptr() {
     return reinterpret_cast<uint8_t*>(data_);
 }
 
+void Node::FreeOverflowPages() {
+    auto& pager = btree_->bucket().pager();
+    for (SlotId slot_id = 0; slot_id < count(); ++slot_id) {
+        auto& slot = data_->slots[slot_id];
+        if (!slot.is_overflow_pages) {
+            continue;
+        }
+        auto overflow_record = reinterpret_cast<OverflowRecord*>(GetRawRecordPtr(slot_id));
+        size_t size = slot.key_size;
+        if (IsLeaf()) {
+            size += slot.value_size;
+        }
+        pager.Free(overflow_record->pgid, pager.GetPageCount(size));
+    }
+}
+
 uint8_t* Node::GetRawRecordPtr(SlotId slot_id) {
     auto& slot = data_->slots[slot_id];
     assert(slot_id < count());
@@ -245,6 +654,12 @@ void Node::StoreRecord(SlotId slot_id, std::span<const uint8_t> key, std::span<c
     auto size = key.size() + value.size();
     auto& slot = data_->slots[slot_id];
     slot.key_size = key.size();
+    if (btree_->key_prefix()) {
+        SetKeyPrefix(slot_id, MakeKeyPrefix(key));
+    }
+    // Inline records leave out the node prefix
+    auto node_prefix = GetNodePrefix();
+    assert(key.size() >= node_prefix.size() && std::equal(node_prefix.begin(), node_prefix.end(), key.begin()));
 
     if (IsLeaf()) {
         slot.value_size = value.size();
@@ -265,6 +680,10 @@ void Node::StoreRecord(SlotId slot_id, std::span<const uint8_t> key, std::span<c
         std::memcpy(overflow_reocrd_ptr, &record, sizeof(record));
     }
     else {
+        key = key.subspan(node_prefix.size());
+        size -= node_prefix.size();
+        slot.key_size = key.size();
+
         assert(data_->header.data_offset >= size);
         data_->header.data_offset -= size;
         data_->header.space_used += size;
@@ -308,29 +727,32 @@ void Node::DeleteRecord(SlotId slot_id) {
     assert(slot_id < count());
     auto& slot = data_->slots[slot_id];
     if (slot.is_overflow_pages) {
+        // Left as an empty inline record, so that Compactify does not copy it
         data_->header.space_used -= sizeof(OverflowRecord);
+        slot.is_overflow_pages = false;
     }
     else {
         data_->header.space_used -= slot.key_size;
-        slot.key_size = 0;
         if (IsLeaf()) {
             data_->header.space_used -= slot.value_size;
-            slot.value_size = 0;
         }
     }
+    slot.key_size = 0;
+    if (IsLeaf()) {
+        slot.value_size = 0;
+    }
 }
 
 void Node::RestoreRecord(SlotId slot_id, const Slot& saved_slot) {
     assert(slot_id < count());
     auto& slot = data_->slots[slot_id];
-    if (saved_slot.is_overflow_pages) {
+    slot = saved_slot;
+    if (slot.is_overflow_pages) {
         data_->header.space_used += sizeof(OverflowRecord);
     }
     else {
-        slot.key_size = saved_slot.key_size;
         data_->header.space_used += slot.key_size;
         if (IsLeaf()) {
-            slot.value_size = saved_slot.value_size;
             data_->header.space_used += slot.value_size;
         }
     }
@@ -343,8 +765,8 @@ void BranchNode::Build(PageId tail_child) {
     header.type = NodeType::kBranch;
     header.count = 0;
 
-    header.data_offset = page_size();
     header.space_used = 0;
+    InitTrailer();
 
     data_->tail_child = tail_child;
     header.last_modified_txid = btree_->bucket().tx().txid();
@@ -418,14 +840,11 @@ bool BranchNode::Update(SlotId slot_id, std::span<const uint8_t> key) {
     assert(slot_id < count());
     auto saved_slot = data_->slots[slot_id];
     DeleteRecord(slot_id);
-    if (!RequestSpaceFor(key, {}, false)) {
+    if (!RequestSpaceFor(key, {}, false, slot_id)) {
         // Insufficient space, restore the deleted record
         RestoreRecord(slot_id, saved_slot);
         return false;
     }
-    auto& slot = data_->slots[slot_id];
-    auto size = slot.key_size;
-    data_->header.space_used -= size;
     StoreRecord(slot_id, key, {});
     assert(SlotSpace() + FreeSpace() == data_->header.data_offset);
     return true;
@@ -441,12 +860,12 @@ bool BranchNode::Insert(SlotId slot_id, std::span<const uint8_t> key, PageId chi
         return false;
     }
 
-    auto& slot = data_->slots[slot_id];
-    std::memmove(data_->slots + slot_id + 1, data_->slots + slot_id,
-        sizeof(Slot) * (count() - slot_id));
+    const bool append = slot_id == count();
+    InsertSlot(slot_id);
 
+    auto& slot = data_->slots[slot_id];
     if (is_right_child) {
-        if (slot_id == count()) {
+        if (append) {
             slot.left_child = data_->tail_child;
             data_->tail_child = child;
         }
@@ -459,7 +878,6 @@ bool BranchNode::Insert(SlotId slot_id, std::span<const uint8_t> key, PageId chi
         slot.left_child = child;
     }
 
-    ++data_->header.count;
     StoreRecord(slot_id, key, {});
     return true;
 }
@@ -480,24 +898,23 @@ void BranchNode::Delete(SlotId slot_id, bool right_child) {
 
     if (right_child) {
         if (slot_id + 1 < count()) {
+            // The next slot takes over this one, keeping the left child
             data_->slots[slot_id + 1].left_child = slot.left_child;
             slot = data_->slots[slot_id + 1];
+            if (btree_->key_prefix()) {
+                SetKeyPrefix(slot_id, GetKeyPrefix(slot_id + 1));
+            }
+            EraseSlot(slot_id + 1);
         }
         else {
             data_->tail_child = data_->slots[count() - 1].left_child;
-        }
-
-        if (count() - slot_id > 1) {
-            std::memmove(data_->slots + slot_id + 1, data_->slots + slot_id + 2,
-                sizeof(Slot) * (count() - slot_id - 2));
+            EraseSlot(slot_id);
         }
     }
     else {
-        std::memmove(data_->slots + slot_id, data_->slots + slot_id + 1,
-            sizeof(Slot) * (count() - slot_id - 1));
+        EraseSlot(slot_id);
     }
 
-    --data_->header.count;
     assert(SlotSpace() + FreeSpace() == data_->header.data_offset);
 }
 
@@ -512,8 +929,8 @@ void LeafNode::Build() {
     header.type = NodeType::kLeaf;
     header.count = 0;
 
-    header.data_offset = page_size();
     header.space_used = 0;
+    InitTrailer();
 
     data_->header.last_modified_txid = btree_->bucket().tx().txid();
 }
@@ -546,7 +963,7 @@ bool LeafNode::Update(SlotId slot_id, std::span<const uint8_t> key, std::span<co
     assert(slot_id < count());
     auto saved_slot = data_->slots[slot_id];
     DeleteRecord(slot_id);
-    if (!RequestSpaceFor(key, value, false)) {
+    if (!RequestSpaceFor(key, value, false, slot_id)) {
         // Insufficient space, restore the deleted record
         RestoreRecord(slot_id, saved_slot);
         return false;
@@ -566,9 +983,7 @@ bool LeafNode::Insert(SlotId slot_id, std::span<const uint8_t> key, std::span<co
     if (!RequestSpaceFor(key, value, true)) {
         return false;
     }
-    std::memmove(data_->slots + slot_id + 1, data_->slots + slot_id,
-        sizeof(Slot) * (count() - slot_id));
-    ++data_->header.count;
+    InsertSlot(slot_id);
     StoreRecord(slot_id, key, value);
     return true;
 }
@@ -588,9 +1003,7 @@ void LeafNode::Delete(SlotId slot_id) {
         data_->header.space_used -= size;
     }
 
-    std::memmove(data_->slots + slot_id, data_->slots + slot_id + 1,
-        sizeof(Slot) * (count() - slot_id - 1));
-    --data_->header.count;
+    EraseSlot(slot_id);
     assert(SlotSpace() + FreeSpace() == data_->header.data_offset);
 }
 
@@ -9,10 +9,19 @@
 
 #include "pager.h"
 
+#include <algorithm>
+#include <cerrno>
+
 #include <atomkv/node.h>
 
 #include "db_impl.h"
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
 namespace atomkv {
 
 Pager::Pager(DBImpl* db, PageSize page_size) 
@@ -38,6 +47,60 @@ void Pager::WriteByBytes(PageId pgid, size_t offset, const uint8_t* buf, size_t
     std::memcpy(dst, buf, bytes);
 }
 
+void Pager::WriteDirtyPages() {
+    WriteDirtyPages(TakeDirtyPages());
+}
+
+void Pager::WriteDirtyPages(DirtyPages dirty_pages) {
+    if (dirty_pages.empty()) {
+        return;
+    }
+    std::sort(dirty_pages.begin(), dirty_pages.end());
+    auto [pgid, count] = dirty_pages[0];
+    for (size_t i = 1; i < dirty_pages.size(); ++i) {
+        auto& [next_pgid, next_count] = dirty_pages[i];
+        if (next_pgid <= pgid + count) {
+            count = std::max<PageCount>(count, next_pgid + next_count - pgid);
+            continue;
+        }
+        SyncPages(pgid, count);
+        pgid = next_pgid;
+        count = next_count;
+    }
+    SyncPages(pgid, count);
+
+#ifdef _WIN32
+    // FlushViewOfFile does not flush the file metadata and the disk cache
+    db_->db_file().sync();
+#endif
+}
+
+void Pager::SyncPages(PageId pgid, PageCount count) {
+    auto ptr = GetPtr(pgid, 0);
+    size_t bytes = static_cast<size_t>(count) * page_size_;
+#ifdef _WIN32
+    if (!::FlushViewOfFile(ptr, bytes)) {
+        throw std::system_error(::GetLastError(), std::system_category(), "Failed to sync db file.");
+    }
+#else
+    if (::msync(ptr, bytes, MS_SYNC) != 0) {
+        throw std::system_error(errno, std::generic_category(), "Failed to sync db file.");
+    }
+#endif
+}
+
+void Pager::Prefetch(PageId pgid, PageCount count) {
+    auto ptr = GetPtr(pgid, 0);
+    const size_t bytes = static_cast<size_t>(count) * page_size_;
+    // Only a hint, failures are ignored
+#ifdef _WIN32
+    WIN32_MEMORY_RANGE_ENTRY range{ ptr, bytes };
+    ::PrefetchVirtualMemory(::GetCurrentProcess(), 1, &range, 0);
+#else
+    ::madvise(ptr, bytes, MADV_WILLNEED);
+#endif
+}
+
 void Pager::WriteAllDirtyPages() {
     //std::vector<PageCount> sort_arr;
     //sort_arr.reserve(db_->options()->cache_pool_page_count);
@@ -75,6 +138,8 @@ void Pager::Rollback() {
         FreeToMap(alloc_pair.first, alloc_pair.second);
     }
     alloc_records_.clear();
+    dirty_pages_.clear();
+    free_list_delta_.resize(free_list_delta_tx_begin_);
 }
 
 PageId Pager::Alloc(PageCount count) {
@@ -89,11 +154,11 @@ PageId Pager::Alloc(PageCount count) {
         page_count += count;
 
         size_t min_size = page_count * page_size_;
-        auto map_size = db_->db_file_mmap().size();
-        if (min_size > map_size) {
-            db_->Remmap(min_size);
+        if (min_size > db_->db_file_size()) {
+            db_->Grow(min_size);
         }
     }
+    dirty_pages_.push_back({ pgid, count });
     return pgid;
 }
 
@@ -108,6 +173,7 @@ void Pager::Free(PageId free_pgid, PageCount free_count) {
         iter = res.first;
     }
     iter->second.push_back({ free_pgid, free_count });
+    free_list_delta_.push_back({ free_pgid, free_count });
 }
 
 Page Pager::Copy(const Page& page) {
@@ -125,6 +191,8 @@ Page Pager::Copy(PageId pgid) {
 
 void Pager::Release(TxId releasable_txid) {
     alloc_records_.clear();
+    dirty_pages_.clear();
+    free_list_delta_tx_begin_ = free_list_delta_.size();
     for (auto iter = pending_map_.begin(); iter != pending_map_.end(); ) {
         if (iter->first >= releasable_txid) {
             break;
@@ -136,21 +204,62 @@ void Pager::Release(TxId releasable_txid) {
     }
 }
 
+bool Pager::Shrink() {
+    const auto threshold = db_->options()->shrink_threshold;
+    if (threshold == 0 || free_map_.empty()) {
+        return false;
+    }
+    auto& page_count = db_->tx_manager().update_tx().meta_struct().page_count;
+    auto iter = std::prev(free_map_.end());
+    auto [pgid, count] = *iter;
+    if (pgid + count != page_count || static_cast<uint64_t>(count) * page_size_ < threshold) {
+        return false;
+    }
+    // Drop the free extent at the end of the file, it is given back on rollback like an allocation
+    EraseFreeExtent(iter);
+    alloc_records_.push_back({ pgid, count });
+    free_list_delta_.push_back({ pgid, count | kFreeListDeltaRemoved });
+#ifndef NDEBUG
+    for (PageCount i = 0; i < count; ++i) {
+        auto erased = debug_free_set_.erase(pgid + i);
+        assert(erased == 1);
+    }
+#endif
+    page_count = pgid;
+    return true;
+}
+
 void Pager::LoadFreeList() {
     auto& meta = db_->meta().meta_struct();
-    if (meta.free_list_pgid == kPageInvalidId) {
-        return;
+    if (meta.free_list_pgid != kPageInvalidId) {
+        auto ptr = GetPtr(meta.free_list_pgid, 0);
+        auto free_list = reinterpret_cast<const PagePair*>(ptr);
+        for (size_t i = 0; i < meta.free_pair_count; ++i) {
+            // SaveFreeList will directly save pending pages that have not been merged
+            // Merge it into the free map here
+            if (free_list[i].second == 0) {
+                continue;
+            }
+            FreeToMap(free_list[i].first, free_list[i].second);
+        }
     }
-    size_t bytes = meta.free_pair_count * sizeof(PagePair);
-    auto ptr = GetPtr(meta.free_list_pgid, 0);
-    auto free_list = reinterpret_cast<const PagePair*>(ptr);
-    for (size_t i = 0; i < meta.free_pair_count; ++i) {
-        // SaveFreeList will directly save pending pages that have not been merged
-        // Merge it into the free map here
-        if (free_list[i].second == 0) {
-            continue;
+
+    // Replay the deltas saved after the free list was rewritten, oldest first
+    std::vector<const FreeListDeltaHeader*> delta_list;
+    for (auto pgid = meta.free_delta_pgid; pgid != kPageInvalidId; ) {
+        auto header = reinterpret_cast<const FreeListDeltaHeader*>(GetPtr(pgid, 0));
+        delta_list.push_back(header);
+        pgid = header->prev_pgid;
+    }
+    for (auto iter = delta_list.rbegin(); iter != delta_list.rend(); ++iter) {
+        auto records = reinterpret_cast<const FreeListDeltaRecord*>(*iter + 1);
+        for (uint32_t i = 0; i < (*iter)->record_count; ++i) {
+            if (records[i].count & kFreeListDeltaRemoved) {
+                RemoveFromMap(records[i].pgid, records[i].count & ~kFreeListDeltaRemoved);
+            } else {
+                FreeToMap(records[i].pgid, records[i].count);
+            }
         }
-        FreeToMap(free_list[i].first, free_list[i].second);
     }
 }
 
@@ -159,39 +268,23 @@ void Pager::SaveFreeList() {
     auto& update_tx = db_->tx_manager().update_tx();
     auto& meta = update_tx.meta_struct();
 
-    // Release the original free_ist
-    if (meta.free_list_pgid != kPageInvalidId) {
-        Free(meta.free_list_pgid, meta.free_list_page_count);
+    if (free_list_delta_.empty()) {
+        return;
     }
 
-    uint32_t pair_count = free_map_.size();
+    // Only the changes are written, until replaying them would cost more than the whole list
+    size_t pair_count = free_map_.size();
     for (auto& pending_pair : pending_map_) {
         pair_count += pending_pair.second.size();
     }
-
-    size_t bytes = pair_count * sizeof(PagePair);
-    meta.free_list_page_count = bytes / page_size();
-    if (bytes % page_size()) {
-        ++meta.free_list_page_count;
-    }
-
-    meta.free_list_pgid = Alloc(meta.free_list_page_count);
-
-    auto buf = std::vector<uint8_t>(bytes);
-    uint32_t i = 0;
-    for (auto& pair : free_map_) {
-        std::memcpy(&buf[i * sizeof(PagePair)], &pair, sizeof(pair));
-        ++i;
-    }
-
-    for (auto& pending_pair : pending_map_) {
-        std::memcpy(&buf[i * sizeof(PagePair)], &pending_pair.second[0], pending_pair.second.size() * sizeof(PagePair));
-        i += pending_pair.second.size();
+    if (meta.free_delta_count + free_list_delta_.size() > pair_count) {
+        RewriteFreeList(&meta);
+    } else {
+        SaveFreeListDelta(&meta);
     }
 
-    meta.free_pair_count = i;
-
-    WriteByBytes(meta.free_list_pgid, 0, buf.data(), meta.free_pair_count * sizeof(PagePair));
+    free_list_delta_.clear();
+    free_list_delta_tx_begin_ = 0;
 }
 
 PageId Pager::GetPageIdByPtr(const uint8_t* page_ptr) const {
@@ -224,37 +317,34 @@ void Pager::Dereference(const uint8_t* page_buf) {
 }
 
 PageId Pager::AllocFromMap(PageCount count) {
-    PageId pgid = kPageInvalidId;
-    for (auto iter = free_map_.begin(); iter != free_map_.end(); ++iter) {
-        auto free_count = iter->second;
-        assert(free_count > 0);
-        if (free_count < count) {
-            continue;
-        }
-        pgid = iter->first;
-        free_map_.erase(iter);
-        if (count < free_count) {
-            free_count -= count;
-            auto free_pgid = pgid + count;
-            auto [_, success] = free_map_.insert({ free_pgid , free_count });
-            assert(success);
-        }
-        alloc_records_.push_back({ pgid, count });
-        break;
+    // Best fit: take the smallest free extent that can hold the request,
+    // the one with the lowest page id among extents of the same size.
+    auto size_iter = free_size_map_.lower_bound({ count, 0 });
+    if (size_iter == free_size_map_.end()) {
+        return kPageInvalidId;
     }
+    auto [free_count, pgid] = *size_iter;
+    assert(free_count >= count);
+    EraseFreeExtent(free_map_.find(pgid));
+    if (count < free_count) {
+        InsertFreeExtent(pgid + count, free_count - count);
+    }
+    alloc_records_.push_back({ pgid, count });
+    free_list_delta_.push_back({ pgid, count | kFreeListDeltaRemoved });
 #ifndef NDEBUG
-    if (pgid != kPageInvalidId) {
-        for (PageCount i = 0; i < count; ++i) {
-            auto iter = debug_free_set_.find(pgid + i);
-            assert(iter != debug_free_set_.end());
-            debug_free_set_.erase(iter);
-        }
+    for (PageCount i = 0; i < count; ++i) {
+        auto iter = debug_free_set_.find(pgid + i);
+        assert(iter != debug_free_set_.end());
+        debug_free_set_.erase(iter);
     }
 #endif
     return pgid;
 }
 
 void Pager::FreeToMap(PageId pgid, PageCount count) {
+    if (count == 0) {
+        return;
+    }
 #ifndef NDEBUG
     for (PageCount i = 0; i < count; ++i) {
         auto [_, success] = debug_free_set_.insert(pgid + i);
@@ -262,24 +352,132 @@ void Pager::FreeToMap(PageId pgid, PageCount count) {
     }
 #endif
 
-    const auto next_pgid = pgid + count;
-    auto tmp_iter = free_map_.lower_bound(pgid);
-    if (tmp_iter != free_map_.end()) {
-        if (tmp_iter->first == next_pgid) {
-            count += tmp_iter->second;
-            free_map_.erase(tmp_iter--);
-        }
-    } else {
-        if (!free_map_.empty()) {
-            tmp_iter = --free_map_.end();
+    // Coalesce with the following extent
+    auto next_iter = free_map_.lower_bound(pgid);
+    if (next_iter != free_map_.end() && next_iter->first == pgid + count) {
+        count += next_iter->second;
+        next_iter = EraseFreeExtent(next_iter);
+    }
+
+    // Coalesce with the preceding extent
+    if (next_iter != free_map_.begin()) {
+        auto prev_iter = std::prev(next_iter);
+        if (prev_iter->first + prev_iter->second == pgid) {
+            pgid = prev_iter->first;
+            count += prev_iter->second;
+            next_iter = EraseFreeExtent(prev_iter);
         }
     }
-    
-    if (tmp_iter != free_map_.end() && tmp_iter->first + tmp_iter->second == pgid) {
-        tmp_iter->second += count;
-    } else {
-        free_map_.insert({ pgid, count });
+
+    InsertFreeExtent(pgid, count, next_iter);
+}
+
+void Pager::InsertFreeExtent(PageId pgid, PageCount count, FreeMap::const_iterator hint) {
+    assert(count > 0);
+    free_map_.emplace_hint(hint, pgid, count);
+    auto [_, success] = free_size_map_.insert({ count, pgid });
+    assert(success);
+}
+
+void Pager::InsertFreeExtent(PageId pgid, PageCount count) {
+    InsertFreeExtent(pgid, count, free_map_.lower_bound(pgid));
+}
+
+Pager::FreeMap::iterator Pager::EraseFreeExtent(FreeMap::iterator iter) {
+    assert(iter != free_map_.end());
+    auto erased = free_size_map_.erase({ iter->second, iter->first });
+    assert(erased == 1);
+    return free_map_.erase(iter);
+}
+
+void Pager::RemoveFromMap(PageId pgid, PageCount count) {
+    // The pages must lie within a single free extent
+    auto iter = free_map_.upper_bound(pgid);
+    assert(iter != free_map_.begin());
+    --iter;
+    auto [free_pgid, free_count] = *iter;
+    assert(free_pgid <= pgid && pgid + count <= free_pgid + free_count);
+    iter = EraseFreeExtent(iter);
+    if (free_pgid < pgid) {
+        InsertFreeExtent(free_pgid, pgid - free_pgid, iter);
+    }
+    if (pgid + count < free_pgid + free_count) {
+        InsertFreeExtent(pgid + count, free_pgid + free_count - pgid - count, iter);
+    }
+#ifndef NDEBUG
+    for (PageCount i = 0; i < count; ++i) {
+        auto erased = debug_free_set_.erase(pgid + i);
+        assert(erased == 1);
+    }
+#endif
+}
+
+void Pager::SaveFreeListDelta(MetaStruct* meta) {
+    // Reserve a record in case the block itself is allocated from the free map
+    const size_t bytes = sizeof(FreeListDeltaHeader) + (free_list_delta_.size() + 1) * sizeof(FreeListDeltaRecord);
+    const PageCount page_count = GetPageCount(bytes);
+    const PageId pgid = Alloc(page_count);
+
+    FreeListDeltaHeader header;
+    header.prev_pgid = meta->free_delta_pgid;
+    header.page_count = page_count;
+    header.record_count = free_list_delta_.size();
+    assert(bytes >= sizeof(header) + header.record_count * sizeof(FreeListDeltaRecord));
+    WriteByBytes(pgid, 0, reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+    WriteByBytes(pgid, sizeof(header), reinterpret_cast<const uint8_t*>(free_list_delta_.data()), header.record_count * sizeof(FreeListDeltaRecord));
+
+    meta->free_delta_pgid = pgid;
+    meta->free_delta_count += header.record_count;
+}
+
+void Pager::RewriteFreeList(MetaStruct* meta) {
+    // Release the original free list and its deltas
+    if (meta->free_list_pgid != kPageInvalidId) {
+        Free(meta->free_list_pgid, meta->free_list_page_count);
+    }
+    for (auto pgid = meta->free_delta_pgid; pgid != kPageInvalidId; ) {
+        auto header = reinterpret_cast<const FreeListDeltaHeader*>(GetPtr(pgid, 0));
+        const auto prev_pgid = header->prev_pgid;
+        Free(pgid, header->page_count);
+        pgid = prev_pgid;
+    }
+    meta->free_delta_pgid = kPageInvalidId;
+    meta->free_delta_count = 0;
+
+    uint32_t pair_count = free_map_.size();
+    for (auto& pending_pair : pending_map_) {
+        pair_count += pending_pair.second.size();
     }
+    if (pair_count == 0) {
+        meta->free_list_pgid = kPageInvalidId;
+        meta->free_pair_count = 0;
+        meta->free_list_page_count = 0;
+        return;
+    }
+
+    size_t bytes = pair_count * sizeof(PagePair);
+    meta->free_list_page_count = bytes / page_size();
+    if (bytes % page_size()) {
+        ++meta->free_list_page_count;
+    }
+
+    meta->free_list_pgid = Alloc(meta->free_list_page_count);
+
+    auto buf = std::vector<uint8_t>(bytes);
+    uint32_t i = 0;
+    for (auto& pair : free_map_) {
+        std::memcpy(&buf[i * sizeof(PagePair)], &pair, sizeof(pair));
+        ++i;
+    }
+
+    for (auto& pending_pair : pending_map_) {
+        std::memcpy(&buf[i * sizeof(PagePair)], &pending_pair.second[0], pending_pair.second.size() * sizeof(PagePair));
+        i += pending_pair.second.size();
+    }
+
+    meta->free_pair_count = i;
+
+    WriteByBytes(meta->free_list_pgid, 0, buf.data(), meta->free_pair_count * sizeof(PagePair));
 }
 
 } // namespace atomkv
\ No newline at end of file
@@ -11,13 +11,17 @@
 
 #include <memory>
 #include <map>
+#include <set>
 #include <unordered_set>
 #include <vector>
 #include <forward_list>
+#include <utility>
 
 #include <atomkv/noncopyable.h>
 #include <atomkv/page.h>
 #include <atomkv/tx_format.h>
+#include <atomkv/meta_format.h>
+#include <atomkv/free_list_format.h>
 
 namespace atomkv {
 
@@ -25,6 +29,9 @@ class DBImpl;
 class UpdateTx;
 
 class Pager : noncopyable {
+public:
+    using DirtyPages = std::vector<std::pair<PageId, PageCount>>;
+
 public:
     Pager(DBImpl* db, PageSize page_size);
     ~Pager();
@@ -32,7 +39,14 @@ public:
     uint8_t* GetPtr(PageId pgid, size_t offset);
     void Write(PageId pgid, const uint8_t* cache, PageCount count);
     void WriteByBytes(PageId pgid, size_t offset, const uint8_t* buf, size_t bytes);
+    void WriteDirtyPages();
+    // Sync the pages of a commit, may run on another thread while the next write transaction runs
+    void WriteDirtyPages(DirtyPages dirty_pages);
+    // Hand over the pages written by the write transaction to be synced later
+    DirtyPages TakeDirtyPages() { return std::exchange(dirty_pages_, {}); }
     void WriteAllDirtyPages();
+    // Asks the OS to read the pages in ahead of access
+    void Prefetch(PageId pgid, PageCount count);
 
     void Rollback();
 
@@ -42,6 +56,7 @@ public:
     Page Copy(PageId pgid);
 
     void Release(TxId releasable_txid);
+    bool Shrink();
 
     void LoadFreeList();
     void SaveFreeList();
@@ -55,11 +70,25 @@ public:
     
     auto& db() const { return *db_; }
     auto& page_size() const { return page_size_; }
+    auto& pending_map() const { return pending_map_; }
+    auto& dirty_pages() const { return dirty_pages_; }
     auto& tmp_page() { return tmp_page_; }
 
 private:
+    using FreeMap = std::map<PageId, PageCount>;
+
     PageId AllocFromMap(PageCount count);
     void FreeToMap(PageId pgid, PageCount count);
+    void RemoveFromMap(PageId pgid, PageCount count);
+
+    void InsertFreeExtent(PageId pgid, PageCount count, FreeMap::const_iterator hint);
+    void InsertFreeExtent(PageId pgid, PageCount count);
+    FreeMap::iterator EraseFreeExtent(FreeMap::iterator iter);
+
+    void SyncPages(PageId pgid, PageCount count);
+
+    void SaveFreeListDelta(MetaStruct* meta);
+    void RewriteFreeList(MetaStruct* meta);
 
 private:
     DBImpl* const db_;
@@ -67,8 +96,18 @@ private:
 
     using PagePair = std::pair<PageId, PageCount>;
     std::map<TxId, std::vector<PagePair>> pending_map_;
-    std::map<PageId, PageCount> free_map_;
+    // Free extents are indexed twice: by start page for coalescing,
+    // and by (count, start page) for best-fit allocation.
+    FreeMap free_map_;
+    std::set<std::pair<PageCount, PageId>> free_size_map_;
     std::vector<PagePair> alloc_records_;
+    // Pages allocated by the write transaction, only these are written since pages are copied on write
+    DirtyPages dirty_pages_;
+
+    // Extents freed or allocated from the free map since the free list was last saved,
+    // in the order they happened. The write transaction's own records start at free_list_delta_tx_begin_.
+    std::vector<FreeListDeltaRecord> free_list_delta_;
+    size_t free_list_delta_tx_begin_{ 0 };
 
     uint8_t* tmp_page_;
 
@@ -10,30 +10,61 @@
 #pragma once
 
 #include <atomic>
+#include <cstddef>
 #include <mutex>
 
 #include <atomkv/noncopyable.h>
 #include <atomkv/meta_format.h>
+#include <atomkv/tx_format.h>
 
 namespace atomkv {
 
+constexpr size_t kCacheLineSize = 64;
+
+// Reader slot states besides the txid of a published snapshot
+constexpr TxId kReaderSlotFree = 0;
+constexpr TxId kReaderSlotClaimed = kTxInvalidId;
+
+// Each read transaction publishes its snapshot txid in its own slot,
+// so readers on different cores never write to the same cache line.
+struct alignas(kCacheLineSize) ReaderSlot {
+    std::atomic<TxId> txid = kReaderSlotFree;
+};
+
+// Seqlock of ShmStruct::view_meta_struct, odd while a commit is publishing it.
+// Kept out of the packed ShmStruct so that the counter is naturally aligned.
+struct alignas(kCacheLineSize) MetaSequence {
+    std::atomic<uint64_t> sequence = 0;
+};
+static_assert(offsetof(MetaSequence, sequence) % alignof(std::atomic<uint64_t>) == 0);
+static_assert(sizeof(ReaderSlot) % alignof(MetaSequence) == 0);
+
+// The shm file starts with Options::max_readers reader slots, then MetaSequence and ShmStruct,
+// the mapping is page aligned so the slots and the sequence stay cache line aligned
 #pragma pack(push, 1)
 struct ShmStruct {
     std::atomic<uint32_t> connections = 0;
     std::mutex update_lock;
-    std::mutex meta_lock;
     MetaStruct meta_struct;
+    MetaStruct view_meta_struct;
 };
 #pragma pack(pop)
 
 class Shm : noncopyable {
 public:
-    Shm(ShmStruct* shm_struct) : 
-        shm_struct_{ shm_struct }
+    Shm(uint8_t* shm_buf, uint32_t reader_slot_count) :
+        reader_slots_{ reinterpret_cast<ReaderSlot*>(shm_buf) },
+        reader_slot_count_{ reader_slot_count },
+        meta_sequence_{ reinterpret_cast<MetaSequence*>(shm_buf + reader_slot_count * sizeof(ReaderSlot)) },
+        shm_struct_{ reinterpret_cast<ShmStruct*>(shm_buf + reader_slot_count * sizeof(ReaderSlot) + sizeof(MetaSequence)) }
     {
         ++shm_struct_->connections;
     }
 
+    static size_t Size(uint32_t reader_slot_count) {
+        return reader_slot_count * sizeof(ReaderSlot) + sizeof(MetaSequence) + sizeof(ShmStruct);
+    }
+
     ~Shm() {
         --shm_struct_->connections;
     }
@@ -42,10 +73,17 @@ public:
     auto& connections() { return shm_struct_->connections; }
     auto& meta_struct() const { return shm_struct_->meta_struct; }
     auto& meta_struct() { return shm_struct_->meta_struct; }
+    auto& view_meta_struct() { return shm_struct_->view_meta_struct; }
     auto& update_lock() { return shm_struct_->update_lock; }
-    auto& meta_lock() { return shm_struct_->meta_lock; }
+    auto& meta_sequence() { return meta_sequence_->sequence; }
+    auto& reader_slot(uint32_t slot_id) const { return reader_slots_[slot_id].txid; }
+    auto& reader_slot(uint32_t slot_id) { return reader_slots_[slot_id].txid; }
+    auto reader_slot_count() const { return reader_slot_count_; }
     
 private:
+    ReaderSlot* const reader_slots_;
+    const uint32_t reader_slot_count_;
+    MetaSequence* const meta_sequence_;
     ShmStruct* const shm_struct_;
 };
 
@@ -43,13 +43,54 @@ void TxImpl::DeleteSubBucket(BucketId bucket_id) {
 void TxImpl::RollBack() {
     if (writable_) {
         tx_manager_->RollBack();
-    } else {
-        tx_manager_->RollBack(txid());
+    } else if (reader_slot_ != kInvalidReaderSlot) {
+        tx_manager_->RollBack(reader_slot_);
+        reader_slot_ = kInvalidReaderSlot;
+    }
+}
+
+void TxImpl::Reset() {
+    assert(!writable_ && reader_slot_ != kInvalidReaderSlot);
+    tx_manager_->ResetView(reader_slot_);
+}
+
+void TxImpl::Renew() {
+    assert(!writable_ && reader_slot_ != kInvalidReaderSlot);
+    const auto old_txid = txid();
+    const auto old_root_pgid = meta_format_.user_root;
+    CopyMetaInfo(&meta_format_, tx_manager_->PublishView(reader_slot_));
+    if (meta_format_.user_root != old_root_pgid || user_bucket_.btree().RootModifiedAfter(old_txid)) {
+        user_bucket_.RenewSubBuckets(old_txid);
     }
 }
 
 void TxImpl::Commit() {
     assert(writable_);
+    FinishBulkLoads();
+    SaveSubBucketRoots();
+    tx_manager_->Commit();
+}
+
+std::future<void> TxImpl::CommitAsync() {
+    assert(writable_);
+    FinishBulkLoads();
+    SaveSubBucketRoots();
+    return tx_manager_->CommitAsync();
+}
+
+void TxImpl::FinishBulkLoads() {
+    // The pages of an open load are not reachable from the root yet
+    if (user_bucket_.btree().loading()) {
+        user_bucket_.FinishBulkLoad();
+    }
+    for (auto& bucket : sub_bucket_cache_) {
+        if (bucket && bucket->btree().loading()) {
+            bucket->FinishBulkLoad();
+        }
+    }
+}
+
+void TxImpl::SaveSubBucketRoots() {
     if (user_bucket_.has_sub_bucket_map()) {
         for (auto& iter : user_bucket_.sub_bucket_map()) {
             user_bucket_.Put(iter.first.c_str(), iter.first.size(), &iter.second.second, sizeof(iter.second.second), true);
@@ -61,16 +102,12 @@ void TxImpl::Commit() {
             bucket->Put(iter.first.c_str(), iter.first.size(), &iter.second.second, sizeof(iter.second.second), true);
         }
     }
-    tx_manager_->Commit();
 }
 
 bool TxImpl::CopyNeeded(TxId txid) const {
     auto current_txid = this->txid();
-    // If the page is allocated by the write transaction currently open in the Wal, and will not be seen by any read transactions, it can be freed
-    if (tx_manager_->IsTxExpired(txid) && txid > tx_manager_->persisted_txid()) {
-        return false;
-    }
-    // If the page is allocated by the current write transaction, it can also be directly freed
+    // Only the pages allocated by the current write transaction can be modified directly,
+    // committed pages may be seen by read transactions opened at any time, or by the persisted version in the Wal
     return txid < current_txid;
 }
 
@@ -86,18 +123,43 @@ void TxImpl::AppendDeleteLog(BucketId bucket_id, std::span<const uint8_t> key) {
     tx_manager_->AppendDeleteLog(bucket_id, key);
 }
 
+void TxImpl::AppendBatchLog(BucketId bucket_id, std::span<const uint8_t> batch) {
+    tx_manager_->AppendBatchLog(bucket_id, batch);
+}
+
+void TxImpl::AppendDeleteRangeLog(BucketId bucket_id, std::span<const uint8_t> begin, std::span<const uint8_t> end) {
+    tx_manager_->AppendDeleteRangeLog(bucket_id, begin, end);
+}
+
 Pager& TxImpl::pager() const { return tx_manager_->pager(); }
 
 
-ViewTx::ViewTx(TxManager* tx_manager, const MetaStruct& meta, std::shared_mutex* mmap_mutex) :
+ViewTx::ViewTx(TxManager* tx_manager, const MetaStruct& meta, std::shared_mutex* mmap_mutex, uint32_t reader_slot) :
     tx_(tx_manager, meta, false),
-    mmap_lock_(*mmap_mutex) {}
+    mmap_lock_(mmap_mutex ? std::shared_lock(*mmap_mutex) : std::shared_lock<std::shared_mutex>())
+{
+    tx_.set_reader_slot(reader_slot);
+}
 
 ViewTx::~ViewTx() {
     tx_.RollBack();
 }
 
 
+void ViewTx::Reset() {
+    tx_.Reset();
+    if (mmap_lock_.owns_lock()) {
+        mmap_lock_.unlock();
+    }
+}
+
+void ViewTx::Renew() {
+    if (mmap_lock_.mutex() && !mmap_lock_.owns_lock()) {
+        mmap_lock_.lock();
+    }
+    tx_.Renew();
+}
+
 ViewBucket ViewTx::UserBucket() {
     auto& root_bucket = tx_.user_bucket();
     return ViewBucket(&root_bucket);
@@ -138,4 +200,92 @@ void UpdateTx::Commit() {
     tx_ = nullptr;
 }
 
+std::future<void> UpdateTx::CommitAsync() {
+    if (tx_ == nullptr) {
+        throw std::runtime_error("Invalid tx.");
+    }
+    auto durable = tx_->CommitAsync();
+    tx_ = nullptr;
+    return durable;
+}
+
+OptimisticTx::OptimisticTx(TxManager* tx_manager) :
+    tx_manager_{ tx_manager },
+    view_tx_(tx_manager->View()) {}
+
+OptimisticTx::~OptimisticTx() = default;
+
+ViewBucket OptimisticTx::SubViewBucket(std::string_view key) {
+    if (committed_) {
+        throw std::runtime_error("Invalid tx.");
+    }
+    Access(key);
+    return ViewBucket(&view_tx_.tx_.user_bucket().SubBucket(key, false));
+}
+
+WriteBatch& OptimisticTx::SubWriteBatch(std::string_view key) {
+    if (committed_) {
+        throw std::runtime_error("Invalid tx.");
+    }
+    auto& access = Access(key);
+    if (!access.batch.has_value()) {
+        access.batch.emplace();
+    }
+    return *access.batch;
+}
+
+bool OptimisticTx::Commit() {
+    if (committed_) {
+        throw std::runtime_error("Invalid tx.");
+    }
+    committed_ = true;
+
+    // Only the recorded roots are needed from the snapshot,
+    // and the mapping must not be held while waiting for the update lock
+    const auto snapshot_txid = view_tx_.tx_.txid();
+    view_tx_.Reset();
+
+    auto update_tx = tx_manager_->Update();
+    auto& user_bucket = update_tx.tx_->user_bucket();
+    for (auto& [key, access] : buckets_) {
+        auto iter = user_bucket.Get(key.data(), key.size());
+        PageId root_pgid = kPageInvalidId;
+        if (iter != user_bucket.end()) {
+            if (!iter.is_bucket()) {
+                // A key value pair was stored at the key after the snapshot
+                return false;
+            }
+            root_pgid = iter.value<PageId>();
+        }
+        // Copy on write, a root that is the same page and was not rewritten means an unchanged bucket
+        if (root_pgid != access.root_pgid || user_bucket.btree().ModifiedAfter(root_pgid, snapshot_txid)) {
+            return false;
+        }
+    }
+    for (auto& [key, access] : buckets_) {
+        if (access.batch.has_value()) {
+            user_bucket.SubBucket(key, true).Write(*access.batch);
+        }
+    }
+    update_tx.Commit();
+    return true;
+}
+
+OptimisticTx::BucketAccess& OptimisticTx::Access(std::string_view key) {
+    auto iter = buckets_.find(key);
+    if (iter != buckets_.end()) {
+        return iter->second;
+    }
+    auto& user_bucket = view_tx_.tx_.user_bucket();
+    auto bucket_iter = user_bucket.Get(key.data(), key.size());
+    PageId root_pgid = kPageInvalidId;
+    if (bucket_iter != user_bucket.end()) {
+        if (!bucket_iter.is_bucket()) {
+            throw std::invalid_argument("attempt to open a key value pair that is not a sub bucket.");
+        }
+        root_pgid = bucket_iter.value<PageId>();
+    }
+    return buckets_.emplace(std::string(key), BucketAccess{ .root_pgid = root_pgid, .batch = std::nullopt }).first->second;
+}
+
 } // atomkv
\ No newline at end of file
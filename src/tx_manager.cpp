@@ -9,6 +9,8 @@
 
 #include "tx_manager.h"
 
+#include <algorithm>
+
 #include "db_impl.h"
 #include "log_type.h"
 
@@ -19,13 +21,21 @@ TxManager::TxManager(DBImpl* db)
 {
     pager().LoadFreeList();
     min_view_txid_ = db_->meta().meta_struct().txid;
+    persisted_txid_ = db_->meta().meta_struct().txid;
 }
 
 TxManager::~TxManager() {
-    auto lock = std::unique_lock(db_->shm()->meta_lock());
+    if (flush_thread_.joinable()) {
+        flush_thread_.join();
+    }
 
-    if (update_tx_.has_value()
-        || !view_tx_map_.empty()) {
+    bool has_view_tx = false;
+    for (uint32_t slot_id = 0; slot_id < db_->shm()->reader_slot_count(); ++slot_id) {
+        if (db_->shm()->reader_slot(slot_id).load(std::memory_order_relaxed) != kReaderSlotFree) {
+            has_view_tx = true;
+        }
+    }
+    if (update_tx_.has_value() || has_view_tx) {
         // throw std::runtime_error("There are write transactions that have not been exited.");
         std::abort();
     }
@@ -33,6 +43,13 @@ TxManager::~TxManager() {
 
 UpdateTx TxManager::Update() {
     db_->shm()->update_lock().lock();
+    try {
+        CheckWritable();
+    }
+    catch (...) {
+        db_->shm()->update_lock().unlock();
+        throw;
+    }
     db_->ClearPendingMmap();
 
     assert(!update_tx_.has_value());
@@ -40,9 +57,8 @@ UpdateTx TxManager::Update() {
     if (db_->options()->mode == DbMode::kWal) {
         AppendBeginLog();
     }
-    
-    auto lock = std::unique_lock(db_->shm()->meta_lock());
 
+    // Only the writer modifies the meta, it can be read directly
     update_tx_.emplace(this, db_->meta().meta_struct(), true);
     update_tx_->set_txid(update_tx_->txid() + 1);
     if (update_tx_->txid() == kTxInvalidId) {
@@ -50,40 +66,50 @@ UpdateTx TxManager::Update() {
     }
 
     // 更新min_view_txid
-    if (view_tx_map_.empty()) {
-        min_view_txid_ = db_->meta().meta_struct().txid;
-    }
-    else {
-        const auto iter = view_tx_map_.cbegin();
-        assert(iter != view_tx_map_.end());
-        min_view_txid_ = iter->first;
+    // Claimed slots that have not published a snapshot yet hold kTxInvalidId and never win.
+    // Starts from the published meta, in kWal it lags the meta of the writer until the log is synced.
+    uint64_t sequence;
+    min_view_txid_ = db_->meta().Snapshot(&sequence).txid;
+    for (uint32_t slot_id = 0; slot_id < db_->shm()->reader_slot_count(); ++slot_id) {
+        const auto view_txid = db_->shm()->reader_slot(slot_id).load(std::memory_order_seq_cst);
+        if (view_txid != kReaderSlotFree && view_txid < min_view_txid_) {
+            min_view_txid_ = view_txid;
+        }
     }
-    pager().Release(min_view_txid_ - 1);
+    // Pages freed after the persisted version may still be referenced by it on disk
+    pager().Release(std::min(min_view_txid_ - 1, persisted_txid_ + 1));
     return UpdateTx(&*update_tx_);
 }
 
 ViewTx TxManager::View() {
-    auto lock = std::unique_lock(db_->shm()->meta_lock());
+    const auto reader_slot = ClaimReaderSlot();
+    const auto meta_struct = PublishView(reader_slot);
+    auto mmap_mutex = db_->db_file_mmap_reserved() ? nullptr : &db_->db_file_mmap_lock();
+    return ViewTx(this, meta_struct, mmap_mutex, reader_slot);
+}
 
-    auto txid = db_->meta().meta_struct().txid;
-    const auto iter = view_tx_map_.find(txid);
-    if (iter == view_tx_map_.end()) {
-        view_tx_map_.insert({ txid, 1});
-    }
-    else {
-        ++iter->second;
-    }
-    return ViewTx(this, db_->meta().meta_struct(), &db_->db_file_mmap_lock());
+MetaStruct TxManager::PublishView(uint32_t reader_slot) {
+    auto& slot = db_->shm()->reader_slot(reader_slot);
+
+    // A writer scanning the slots before the store may release pages of this snapshot
+    // once a later commit is published. If nothing was published since the copy,
+    // every later scan is ordered after the store and sees it.
+    MetaStruct meta_struct;
+    uint64_t sequence;
+    do {
+        meta_struct = db_->meta().Snapshot(&sequence);
+        slot.store(meta_struct.txid, std::memory_order_seq_cst);
+    } while (db_->meta().sequence() != sequence);
+    return meta_struct;
 }
 
-void TxManager::RollBack() {
-    auto lock = std::unique_lock(db_->shm()->meta_lock());
+void TxManager::ResetView(uint32_t reader_slot) {
+    db_->shm()->reader_slot(reader_slot).store(kReaderSlotClaimed, std::memory_order_release);
+}
 
+void TxManager::RollBack() {
     if (db_->options()->mode == DbMode::kWal) {
         AppendRollbackLog();
-        if (db_->logger().CheckPointNeeded()) {
-            db_->logger().Checkpoint();
-        }
     }
     
     pager().Rollback();
@@ -92,45 +118,148 @@ void TxManager::RollBack() {
     db_->shm()->update_lock().unlock();
 }
 
-void TxManager::RollBack(TxId view_txid) {
-    auto lock = std::unique_lock(db_->shm()->meta_lock());
+void TxManager::RollBack(uint32_t reader_slot) {
+    assert(db_->shm()->reader_slot(reader_slot).load(std::memory_order_relaxed) != kReaderSlotFree);
+    db_->shm()->reader_slot(reader_slot).store(kReaderSlotFree, std::memory_order_release);
+}
 
-    const auto iter = view_tx_map_.find(view_txid);
-    assert(iter != view_tx_map_.end());
-    assert(iter->second > 0);
-    --iter->second;
-    if (iter->second == 0) {
-        view_tx_map_.erase(iter);
+void TxManager::CheckWritable() const {
+    if (flush_failed_) {
+        throw std::runtime_error("The sync of a commit failed, the database no longer accepts write transactions.");
+    }
+    if (db_->logger().checkpoint_failed()) {
+        db_->logger().ThrowCheckpointError();
     }
 }
 
 void TxManager::Commit() {
-    auto lock = std::unique_lock(db_->shm()->meta_lock());
+    WaitFlush();
+    // The transaction may have been built on a version that failed to sync
+    CheckWritable();
 
-    db_->meta().Reset(update_tx_->meta_struct());
+    const bool shrunk = db_->pager().Shrink();
 
+    uint64_t lsn = 0;
     if (db_->options()->mode == DbMode::kWal) {
-        AppendCommitLog();
+        // The next writer continues from this commit,
+        // readers see it once the log is synced by SyncLog
+        CopyMetaInfo(&db_->meta().meta_struct(), update_tx_->meta_struct());
+        lsn = AppendCommitLog();
         if (db_->logger().CheckPointNeeded()) {
-            db_->logger().Checkpoint();
+            db_->logger().AsyncCheckpoint();
         }
     }
     else if (db_->options()->mode == DbMode::kUpdateInPlace) {
-        db_->pager().SaveFreeList();
-        db_->pager().WriteAllDirtyPages();
+        FlushCommit(db_->pager().TakeDirtyPages(), SaveCommitMeta());
+        // Readers no longer wait for the commit, publish the version once it is durable
+        db_->meta().Reset(update_tx_->meta_struct());
+    }
+
+    EndCommit(shrunk);
+
+    if (lsn != 0) {
+        // Wait for the sync after releasing the update lock,
+        // so the commits of the following writers can share it,
+        // the commit is visible to readers when this returns
+        db_->logger().SyncLog(lsn);
+    }
+}
+
+std::future<void> TxManager::CommitAsync() {
+    std::promise<void> durable;
+    auto future = durable.get_future();
+    if (db_->options()->mode != DbMode::kUpdateInPlace) {
+        // The log is already synced after the update lock is released
+        Commit();
+        durable.set_value();
+        return future;
+    }
+
+    // The meta is saved by the flush thread, one commit is synced at a time
+    WaitFlush();
+    CheckWritable();
+
+    const bool shrunk = db_->pager().Shrink();
+
+    const MetaStruct meta_struct = SaveCommitMeta();
+    db_->meta().Reset(update_tx_->meta_struct());
+
+    // The pages of this version are not written again, later writers copy them,
+    // and the pages it frees are not reused before persisted_txid_ reaches it
+    flush_thread_ = std::thread([this, dirty_pages = db_->pager().TakeDirtyPages(), meta_struct, durable = std::move(durable)]() mutable {
+        try {
+            FlushCommit(std::move(dirty_pages), meta_struct);
+            durable.set_value();
+        }
+        catch (...) {
+            // The version stays visible in this process but is not durable,
+            // later commits would build on it, so writers are refused from now on
+            flush_failed_ = true;
+            durable.set_exception(std::current_exception());
+        }
+    });
+
+    EndCommit(shrunk);
+    return future;
+}
+
+MetaStruct TxManager::SaveCommitMeta() {
+    // The free list is saved into the transaction's meta, so it must precede the copy
+    db_->pager().SaveFreeList();
+    MetaStruct meta_struct = db_->meta().meta_struct();
+    CopyMetaInfo(&meta_struct, update_tx_->meta_struct());
+    return meta_struct;
+}
+
+void TxManager::FlushCommit(Pager::DirtyPages dirty_pages, const MetaStruct& meta_struct) {
+    db_->pager().WriteDirtyPages(std::move(dirty_pages));
+
+    auto& meta = db_->meta();
+    meta.Switch();
+    meta.Save(meta_struct);
 
-        db_->meta().Switch();
-        db_->meta().Save();
+    persisted_txid_ = meta_struct.txid;
+}
+
+void TxManager::EndCommit(bool shrunk) {
+    if (shrunk) {
+        // The truncated pages are free, no view can reference them
+        db_->Shrink(static_cast<uint64_t>(update_tx_->meta_struct().page_count) * db_->options()->page_size);
     }
 
     update_tx_ = std::nullopt;
     db_->shm()->update_lock().unlock();
 }
 
+void TxManager::WaitFlush() {
+    if (!flush_thread_.joinable()) {
+        return;
+    }
+    flush_thread_.join();
+}
+
 bool TxManager::IsTxExpired(TxId txid) const {
     return txid < min_view_txid_;
 }
 
+uint32_t TxManager::ClaimReaderSlot() {
+    // A thread starts from the slot it used last time, so in the common case
+    // the claim is a single uncontended CAS on a cache line no other thread touches
+    thread_local uint32_t hint = 0;
+    const auto slot_count = db_->shm()->reader_slot_count();
+    for (uint32_t i = 0; i < slot_count; ++i) {
+        const auto slot_id = (hint + i) % slot_count;
+        auto& slot = db_->shm()->reader_slot(slot_id);
+        auto expected = kReaderSlotFree;
+        if (slot.load(std::memory_order_relaxed) == kReaderSlotFree
+            && slot.compare_exchange_strong(expected, kReaderSlotClaimed, std::memory_order_acq_rel)) {
+            hint = slot_id;
+            return slot_id;
+        }
+    }
+    throw std::runtime_error("Too many read transactions, see Options::max_readers.");
+}
+
 void TxManager::AppendSubBucketLog(BucketId bucket_id, std::span<const uint8_t> key) {
     BucketLogHeader format;
     format.type = LogType::kSubBucket;
@@ -174,6 +303,35 @@ void TxManager::AppendDeleteLog(BucketId bucket_id, std::span<const uint8_t> key
     db_->logger().AppendLog(std::begin(arr), std::end(arr));
 }
 
+void TxManager::AppendBatchLog(BucketId bucket_id, std::span<const uint8_t> batch) {
+    if (db_->options()->mode != DbMode::kWal) {
+        return;
+    }
+
+    BucketLogHeader format;
+    format.type = LogType::kBatch;
+    format.bucket_id = bucket_id;
+    std::span<const uint8_t> arr[2];
+    arr[0] = { reinterpret_cast<const uint8_t*>(&format), kBucketBatchLogHeaderSize };
+    arr[1] = batch;
+    db_->logger().AppendLog(std::begin(arr), std::end(arr));
+}
+
+void TxManager::AppendDeleteRangeLog(BucketId bucket_id, std::span<const uint8_t> begin, std::span<const uint8_t> end) {
+    if (db_->options()->mode != DbMode::kWal) {
+        return;
+    }
+
+    BucketLogHeader format;
+    format.type = LogType::kDeleteRange;
+    format.bucket_id = bucket_id;
+    std::span<const uint8_t> arr[3];
+    arr[0] = { reinterpret_cast<const uint8_t*>(&format), kBucketDeleteRangeLogHeaderSize };
+    arr[1] = begin;
+    arr[2] = end;
+    db_->logger().AppendLog(std::begin(arr), std::end(arr));
+}
+
 DBImpl& TxManager::db() {
     return *db_;
 }
@@ -205,12 +363,12 @@ void TxManager::AppendRollbackLog() {
     db_->logger().AppendLog(std::begin(arr), std::end(arr));
 }
 
-void TxManager::AppendCommitLog() {
+uint64_t TxManager::AppendCommitLog() {
     LogType type = LogType::kCommit;
     std::span<const uint8_t> arr[1];
     arr[0] = { reinterpret_cast<const uint8_t*>(&type), sizeof(type) };
     db_->logger().AppendLog(std::begin(arr), std::end(arr));
-    db_->logger().FlushLog();
+    return db_->logger().FlushLog();
 }
 
 } // namespace atomkv
\ No newline at end of file
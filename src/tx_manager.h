@@ -10,17 +10,19 @@
 #pragma once
 
 #include <atomic>
+#include <exception>
+#include <future>
 #include <optional>
-#include <map>
+#include <thread>
 
 #include <wal/writer.h>
 
-#include <pool/static_memory_pool.hpp>
-
 #include <atomkv/noncopyable.h>
 #include <atomkv/tx.h>
 #include <atomkv/tx_impl.h>
 
+#include "pager.h"
+
 namespace atomkv {
 
 class DBImpl;
@@ -34,39 +36,65 @@ public:
     ViewTx View();
 
     // Read transaction rollback
-    void RollBack(TxId view_txid);
+    void RollBack(uint32_t reader_slot);
+    // Publish the latest meta in the reader slot and return it
+    MetaStruct PublishView(uint32_t reader_slot);
+    // Keep the reader slot but no longer hold back any version
+    void ResetView(uint32_t reader_slot);
     // Write transaction rollback
     void RollBack();
     // Write transaction commit
     void Commit();
+    // Write transaction commit, in kUpdateInPlace the pages and the meta are synced in the background,
+    // the version is visible to readers and the next writer can start before it is durable
+    std::future<void> CommitAsync();
+    // Wait until the background sync of the last commit is done, its error is only reported by the future
+    void WaitFlush();
+    // Throws once a background sync or checkpoint failed, write transactions are refused from then on
+    void CheckWritable() const;
 
     bool IsTxExpired(TxId view_txid) const;
 
     void AppendSubBucketLog(BucketId bucket_id, std::span<const uint8_t> key);
     void AppendPutLog(BucketId bucket_id, std::span<const uint8_t> key, std::span<const uint8_t> value, bool is_bucket);
     void AppendDeleteLog(BucketId bucket_id, std::span<const uint8_t> key);
+    void AppendBatchLog(BucketId bucket_id, std::span<const uint8_t> batch);
+    void AppendDeleteRangeLog(BucketId bucket_id, std::span<const uint8_t> begin, std::span<const uint8_t> end);
 
     DBImpl& db();
     Pager& pager() const;
     bool has_update_tx() const { return update_tx_.has_value(); };
     TxImpl& update_tx();
     TxImpl& view_tx(ViewTx* view_tx);
-    auto& persisted_txid() const { return persisted_txid_; }
+    TxId persisted_txid() const { return persisted_txid_; }
     void set_persisted_txid(TxId new_persisted_txid) { persisted_txid_ = new_persisted_txid; }
 
 private:
     void AppendBeginLog();
     void AppendRollbackLog();
-    void AppendCommitLog();
+    uint64_t AppendCommitLog();
+
+    // kUpdateInPlace commit steps shared by Commit and CommitAsync
+    // Saves the free list and returns the meta of the commit
+    MetaStruct SaveCommitMeta();
+    // Writes the pages and the meta, after which the commit is durable
+    void FlushCommit(Pager::DirtyPages dirty_pages, const MetaStruct& meta_struct);
+    // Truncates the file if the commit shrank it and releases the update lock
+    void EndCommit(bool shrunk);
+
+    uint32_t ClaimReaderSlot();
 
 private:
     DBImpl* const db_;
 
-    TxId persisted_txid_{ kTxInvalidId };
+    // Updated by the background checkpoint in kWal
+    std::atomic<TxId> persisted_txid_{ kTxInvalidId };
     std::optional<TxImpl> update_tx_;
 
-    std::map<TxId, uint32_t, std::less<>,
-        pool::StaticMemoryPool<std::pair<const TxId, uint32_t>>> view_tx_map_;      // txid : view_tx_count
+    // Syncs the commit of CommitAsync, only one is in flight
+    std::thread flush_thread_;
+    std::atomic<bool> flush_failed_{ false };
+
     TxId min_view_txid_;        // Only updated in write transactions
 
 };
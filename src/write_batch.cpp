@@ -0,0 +1,71 @@
+//The MIT License(MIT)
+//Copyright © 2024 https://github.com/yuyuaqwq
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files(the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and /or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include "atomkv/write_batch.h"
+
+#include <cstdint>
+#include <stdexcept>
+
+#include "atomkv/slot.h"
+
+#include "log_type.h"
+
+namespace atomkv {
+
+namespace {
+
+void AppendSize(std::string* rep, size_t size) {
+    const auto size32 = static_cast<uint32_t>(size);
+    rep->append(reinterpret_cast<const char*>(&size32), sizeof(size32));
+}
+
+} // namespace
+
+WriteBatch::WriteBatch() = default;
+
+WriteBatch::~WriteBatch() = default;
+
+void WriteBatch::Put(const void* key_buf, size_t key_size, const void* value_buf, size_t value_size) {
+    if (key_size > kKeyMaxSize) {
+        throw std::invalid_argument("Key size exceeds the limit.");
+    }
+    if (value_size > kValueMaxSize) {
+        throw std::invalid_argument("Value size exceeds the limit.");
+    }
+    rep_.push_back(static_cast<char>(LogType::kPut_NotBucket));
+    AppendSize(&rep_, key_size);
+    rep_.append(reinterpret_cast<const char*>(key_buf), key_size);
+    AppendSize(&rep_, value_size);
+    rep_.append(reinterpret_cast<const char*>(value_buf), value_size);
+    ++count_;
+}
+
+void WriteBatch::Put(std::string_view key, std::string_view value) {
+    Put(key.data(), key.size(), value.data(), value.size());
+}
+
+void WriteBatch::Delete(const void* key_buf, size_t key_size) {
+    if (key_size > kKeyMaxSize) {
+        throw std::invalid_argument("Key size exceeds the limit.");
+    }
+    rep_.push_back(static_cast<char>(LogType::kDelete));
+    AppendSize(&rep_, key_size);
+    rep_.append(reinterpret_cast<const char*>(key_buf), key_size);
+    ++count_;
+}
+
+void WriteBatch::Delete(std::string_view key) {
+    Delete(key.data(), key.size());
+}
+
+void WriteBatch::Clear() {
+    rep_.clear();
+    count_ = 0;
+}
+
+} // namespace atomkv
@@ -9,6 +9,11 @@
 
 #include <gtest/gtest.h>
 
+#include <array>
+#include <cstdio>
+#include <map>
+#include <random>
+
 #include "atomkv/node.h"
 
 #include "src/db_impl.h"
@@ -375,6 +380,132 @@ TEST_F(BTreeTest, LeafMerge2) {
     ASSERT_EQ(btree_->begin(), btree_->end());
 }
 
+TEST_F(BTreeTest, UInt64Order) {
+    Open(UInt64Comparator);
+    for (uint64_t i = 0; i < 1000; ++i) {
+        // Keys that differ only in the high half
+        uint64_t key = (i * 7919 % 1000) << 32;
+        std::span span = { reinterpret_cast<uint8_t*>(&key), sizeof(key) };
+        btree_->Put(span, span, false);
+    }
+    uint64_t i = 0;
+    for (auto iter = btree_->begin(); iter != btree_->end(); ++iter, ++i) {
+        ASSERT_EQ(iter->key<uint64_t>(), i << 32);
+    }
+    ASSERT_EQ(i, 1000);
+}
+
+TEST_F(BTreeTest, BigEndianOrder) {
+    Open(UInt32BigEndianComparator);
+    for (uint32_t i = 0; i < 1000; ++i) {
+        const uint32_t value = i * 7919 % 1000 * 0x10101;
+        const uint8_t key[] = { uint8_t(value >> 24), uint8_t(value >> 16), uint8_t(value >> 8), uint8_t(value) };
+        btree_->Put(key, key, false);
+    }
+    uint32_t prev = 0;
+    size_t count = 0;
+    for (auto iter = btree_->begin(); iter != btree_->end(); ++iter, ++count) {
+        auto key = iter->key();
+        const uint32_t value = uint32_t(uint8_t(key[0])) << 24 | uint32_t(uint8_t(key[1])) << 16 | uint32_t(uint8_t(key[2])) << 8 | uint8_t(key[3]);
+        ASSERT_TRUE(count == 0 || prev < value);
+        prev = value;
+    }
+    ASSERT_EQ(count, 1000);
+}
+
+TEST_F(BTreeTest, SeparatorKey) {
+    // Long keys that differ early, and keys that extend others, the branch nodes only keep short separators
+    std::vector<std::string> keys;
+    for (int i = 0; i < 2000; ++i) {
+        auto key = std::to_string(i * 7919 % 2000);
+        keys.push_back(key + std::string(1000, 'x'));
+        keys.push_back(key);
+    }
+    for (auto& key : keys) {
+        btree_->Put(FromString(key), FromString(key.substr(0, 8)), false);
+    }
+    std::sort(keys.begin(), keys.end());
+    size_t i = 0;
+    for (auto iter = btree_->begin(); iter != btree_->end(); ++iter, ++i) {
+        ASSERT_EQ(iter->key(), keys[i]);
+    }
+    ASSERT_EQ(i, keys.size());
+    for (i = 0; i < keys.size(); i += 2) {
+        ASSERT_TRUE(btree_->Delete(FromString(keys[i])));
+    }
+    for (i = 0; i < keys.size(); ++i) {
+        auto iter = btree_->Get(FromString(keys[i]));
+        if (i % 2 == 0) {
+            ASSERT_EQ(iter, btree_->end());
+        } else {
+            ASSERT_EQ(iter->key(), keys[i]);
+            ASSERT_EQ(iter->value(), keys[i].substr(0, 8));
+        }
+    }
+}
+
+TEST_F(BTreeTest, SequentialSplit) {
+    // Sequential loads along either edge of the tree leave the nodes nearly full
+    const std::string value(100, 'v');
+    std::vector<uint32_t> keys;
+    for (uint32_t i = 0; i < 20000; ++i) {
+        keys.push_back(i);
+    }
+    auto fill = [&](auto begin, auto end) {
+        Open(UInt32Comparator);
+        for (auto it = begin; it != end; ++it) {
+            std::span span = { reinterpret_cast<const uint8_t*>(&*it), sizeof(*it) };
+            btree_->Put(span, FromString(value), false);
+        }
+        uint32_t i = 0;
+        for (auto iter = btree_->begin(); iter != btree_->end(); ++iter, ++i) {
+            EXPECT_EQ(iter->key<uint32_t>(), i);
+        }
+        EXPECT_EQ(i, keys.size());
+        // Nothing is freed within the transaction, the next page is the number of pages used
+        return pager_->Alloc(1);
+    };
+    const auto ascending_pages = fill(keys.begin(), keys.end());
+    const auto descending_pages = fill(keys.rbegin(), keys.rend());
+    std::shuffle(keys.begin(), keys.end(), std::mt19937{ 1 });
+    const auto random_pages = fill(keys.begin(), keys.end());
+    ASSERT_LT(ascending_pages * 4, random_pages * 3);
+    ASSERT_LT(descending_pages * 4, random_pages * 3);
+}
+
+TEST_F(BTreeTest, RightmostPut) {
+    // Appends go straight to the rightmost leaf, mixed with writes that restructure the tree
+    Open(UInt32BigEndianComparator);
+    std::map<uint32_t, std::string> map;
+    auto key_of = [](uint32_t i) {
+        return std::array<uint8_t, 4>{ uint8_t(i >> 24), uint8_t(i >> 16), uint8_t(i >> 8), uint8_t(i) };
+    };
+    for (uint32_t i = 0; i < 20000; ++i) {
+        auto key = key_of(i * 2);
+        auto value = std::to_string(i);
+        btree_->Put(key, FromString(value), false);
+        map[i * 2] = value;
+        if (i % 100 == 99) {
+            // Delete and fill in below the last key
+            for (uint32_t j = i - 50; j < i; ++j) {
+                ASSERT_TRUE(btree_->Delete(key_of(j * 2)));
+                map.erase(j * 2);
+            }
+            auto middle = key_of(i * 2 - 101);
+            btree_->Put(middle, FromString(value), false);
+            map[i * 2 - 101] = value;
+        }
+    }
+    auto map_iter = map.begin();
+    for (auto iter = btree_->begin(); iter != btree_->end(); ++iter, ++map_iter) {
+        ASSERT_NE(map_iter, map.end());
+        auto key = key_of(map_iter->first);
+        ASSERT_EQ(iter->key(), std::string_view(reinterpret_cast<const char*>(key.data()), key.size()));
+        ASSERT_EQ(iter->value(), map_iter->second);
+    }
+    ASSERT_EQ(map_iter, map.end());
+}
+
 TEST_F(BTreeTest, BranchSplit) {
     const std::string key1(2031, '1');
     const std::string value = "";
@@ -501,4 +632,95 @@ TEST_F(BTreeTest, Iteration) {
     ASSERT_EQ(i, 10000);
 }
 
-} // namespace atomkv
\ No newline at end of file
+TEST_F(BTreeTest, ReverseIteration) {
+    Open(UInt32Comparator);
+    for (int i = 0; i < 10000; ++i) {
+        std::span span = { reinterpret_cast<uint8_t*>(&i) ,sizeof(i) };
+        btree_->Put(span, span, false);
+    }
+    // Stepping back from end descends through the tail child of every branch
+    int i = 10000;
+    auto iter = btree_->end();
+    while (iter != btree_->begin()) {
+        --iter;
+        --i;
+        ASSERT_EQ(iter.key<int>(), i);
+        ASSERT_EQ(iter.value<int>(), i);
+    }
+    ASSERT_EQ(i, 0);
+}
+
+TEST_F(BTreeTest, PrefetchLeaves) {
+    // Long keys keep the fan-out low, so the leaves hang off several parents
+    auto Key = [](int i) {
+        char buf[65];
+        std::snprintf(buf, sizeof(buf), "%064d", i);
+        return std::string(buf);
+    };
+    const int count = 20000;
+    for (int i = 0; i < count; ++i) {
+        auto key = Key(i);
+        btree_->Put(FromString(key), FromString(std::to_string(i)), false);
+    }
+
+    // Each parent is prefetched from once, in order
+    std::vector<PageId> parents;
+    std::vector<int> parent_begin;
+    int i = 0;
+    for (auto iter = btree_->begin(); iter != btree_->end(); ++iter, ++i) {
+        ASSERT_EQ(iter.key(), Key(i));
+        ASSERT_EQ(iter.value(), std::to_string(i));
+        if (iter.prefetch_pgid() != kPageInvalidId && (parents.empty() || parents.back() != iter.prefetch_pgid())) {
+            ASSERT_EQ(std::find(parents.begin(), parents.end(), iter.prefetch_pgid()), parents.end());
+            parents.push_back(iter.prefetch_pgid());
+            parent_begin.push_back(i);
+        }
+    }
+    ASSERT_EQ(i, count);
+    ASSERT_GE(parents.size(), 3);
+
+    // Turn back into the previous parent half way through the scan, then go forward again
+    const int turn = parent_begin[2] + 10;
+    auto iter = btree_->begin();
+    for (i = 0; i < turn; ++i) {
+        ++iter;
+    }
+    ASSERT_EQ(iter.prefetch_pgid(), parents[2]);
+    const auto prefetch_slot_id = iter.prefetch_slot_id();
+    for (; i > parent_begin[1] - 10; --i) {
+        --iter;
+        ASSERT_EQ(iter.key(), Key(i - 1));
+    }
+    // Prev leaves the window alone
+    ASSERT_EQ(iter.prefetch_pgid(), parents[2]);
+    ASSERT_EQ(iter.prefetch_slot_id(), prefetch_slot_id);
+
+    bool reset = false;
+    for (; iter != btree_->end(); ++iter, ++i) {
+        ASSERT_EQ(iter.key(), Key(i));
+        ASSERT_EQ(iter.value(), std::to_string(i));
+        if (iter.prefetch_pgid() == parents[1]) {
+            reset = true;
+        }
+        if (i >= parent_begin[2] && iter.prefetch_pgid() == parents[2]) {
+            // Back in the parent it was turned in, the window starts over
+            ASSERT_TRUE(reset);
+        }
+    }
+    ASSERT_EQ(i, count);
+    ASSERT_TRUE(reset);
+
+    // A sequential scan reads further ahead, other iterators are unaffected
+    auto sequential_iter = btree_->begin();
+    sequential_iter.set_sequential(true);
+    auto plain_iter = btree_->begin();
+    while (sequential_iter.prefetch_pgid() == kPageInvalidId) {
+        ++sequential_iter;
+        ++plain_iter;
+    }
+    ASSERT_EQ(plain_iter.prefetch_pgid(), sequential_iter.prefetch_pgid());
+    ASSERT_GT(sequential_iter.prefetch_slot_id(), plain_iter.prefetch_slot_id());
+    ASSERT_EQ(sequential_iter.key(), plain_iter.key());
+}
+
+} // namespace atomkv
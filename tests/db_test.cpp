@@ -7,6 +7,7 @@
 //
 //THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
+#include <cstdio>
 #include <iostream>
 #include <thread>
 #include <set>
@@ -16,10 +17,16 @@
 #include <unordered_set>
 #include <span>
 #include <filesystem>
+#include <fstream>
 
 #include <gtest/gtest.h>
 
+#include <wal/crc32.h>
+
 #include "atomkv/db.h"
+#include "atomkv/meta_format.h"
+#include "atomkv/version.h"
+#include "src/db_impl.h"
 
 namespace atomkv {
 
@@ -34,10 +41,7 @@ public:
         Open();
     }
 
-    void Open() {
-        atomkv::Options options{
-            .max_wal_size = 1024 * 1024 * 64,
-        };
+    void Open(const atomkv::Options& options = { .max_wal_size = 1024 * 1024 * 64 }) {
         //std::string path = testing::TempDir() + "db_test.ydb";
         std::string path = "Z:/db_test.ydb";
         std::filesystem::remove(path);
@@ -47,6 +51,10 @@ public:
         ASSERT_FALSE(!db_);
     }
 
+    auto FileSize() {
+        return std::filesystem::file_size("Z:/db_test.ydb");
+    }
+
     auto Update() {
         return db_->Update();
     }
@@ -106,6 +114,469 @@ TEST_F(DBTest, UpdateAndView) {
     ASSERT_EQ(iter, view_bucket2.end());
 }
 
+TEST_F(DBTest, ConcurrentView) {
+    {
+        auto tx = Update();
+        auto bucket = tx.UserBucket();
+        for (int i = 0; i < 100; ++i) {
+            bucket.Put(std::to_string(i), "0");
+        }
+        tx.Commit();
+    }
+
+    // Every update rewrites all keys with the same value, so each snapshot must see one value
+    std::atomic<int> failures = 0;
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&] {
+            for (int n = 0; n < 1000; ++n) {
+                auto tx = View();
+                auto bucket = tx.UserBucket();
+                auto expected = std::string(bucket.Get("0").value());
+                for (int i = 1; i < 100; ++i) {
+                    auto iter = bucket.Get(std::to_string(i));
+                    if (iter == bucket.end() || iter.value() != expected) {
+                        ++failures;
+                    }
+                }
+            }
+        });
+    }
+    for (int n = 1; n <= 50; ++n) {
+        auto tx = Update();
+        auto bucket = tx.UserBucket();
+        for (int i = 0; i < 100; ++i) {
+            bucket.Put(std::to_string(i), std::to_string(n));
+        }
+        tx.Commit();
+    }
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    ASSERT_EQ(failures, 0);
+
+    // Each open read transaction holds a reader slot until it ends
+    std::vector<std::unique_ptr<ViewTx>> views;
+    ASSERT_THROW({
+        for (;;) {
+            views.emplace_back(new ViewTx(View()));
+        }
+    }, std::runtime_error);
+    ASSERT_GT(views.size(), 0);
+    views.pop_back();
+    views.emplace_back(new ViewTx(View()));
+    views.clear();
+}
+
+TEST_F(DBTest, ResetAndRenew) {
+    // The views stay open while this thread writes, the growing file must not wait for them
+    db_.reset();
+    Open({ .max_wal_size = 1024 * 1024 * 64, .map_size = 1024 * 1024 * 64 });
+
+    {
+        auto tx = Update();
+        auto bucket = tx.UserBucket();
+        bucket.Put("k1", "v1");
+        bucket.SubUpdateBucket("sub").Put("a", "1");
+        bucket.SubUpdateBucket("other").Put("b", "1");
+        tx.Commit();
+    }
+
+    auto view_tx = View();
+    auto view_bucket = view_tx.UserBucket();
+    auto sub_bucket = view_bucket.SubViewBucket("sub");
+    auto other_bucket = view_bucket.SubViewBucket("other");
+
+    {
+        auto tx = Update();
+        auto bucket = tx.UserBucket();
+        bucket.Put("k1", "v2");
+        bucket.SubUpdateBucket("sub").Put("a", "2");
+        tx.Commit();
+    }
+    ASSERT_EQ(view_bucket.Get("k1").value(), "v1");
+    ASSERT_EQ(sub_bucket.Get("a").value(), "1");
+
+    view_tx.Reset();
+    view_tx.Renew();
+    ASSERT_EQ(view_bucket.Get("k1").value(), "v2");
+    ASSERT_EQ(sub_bucket.Get("a").value(), "2");
+    ASSERT_EQ(other_bucket.Get("b").value(), "1");
+
+    {
+        auto tx = Update();
+        auto bucket = tx.UserBucket();
+        bucket.DeleteSubBucket("sub");
+        bucket.SubUpdateBucket("other").Put("b", "2");
+        tx.Commit();
+    }
+    view_tx.Renew();
+    ASSERT_EQ(sub_bucket.begin(), sub_bucket.end());
+    ASSERT_EQ(other_bucket.Get("b").value(), "2");
+
+    // A parked transaction does not keep the pages of its snapshot
+    auto rewrite = [&]() {
+        for (int n = 0; n < 50; ++n) {
+            auto tx = Update();
+            auto bucket = tx.UserBucket();
+            for (int i = 0; i < 1000; ++i) {
+                bucket.Put(std::to_string(i), std::string(100, 'a' + n % 26));
+            }
+            tx.Commit();
+        }
+    };
+    view_tx.Reset();
+    rewrite();
+    auto file_size = FileSize();
+    rewrite();
+    ASSERT_EQ(FileSize(), file_size);
+
+    view_tx.Renew();
+    ASSERT_EQ(view_bucket.Get("999").value(), std::string(100, 'a' + 49 % 26));
+}
+
+TEST_F(DBTest, ReservedMap) {
+    db_.reset();
+    Open({ .max_wal_size = 1024 * 1024 * 64, .map_size = 1024 * 1024 });
+
+    // Growing the file no longer waits for read transactions
+    auto view_tx = View();
+    int count = 0;
+    ASSERT_THROW({
+        for (;; ++count) {
+            auto tx = Update();
+            auto bucket = tx.UserBucket();
+            bucket.Put(std::to_string(count), std::string(1000, 'v'));
+            tx.Commit();
+        }
+    }, std::runtime_error);
+    ASSERT_GT(count, 0);
+
+    auto tx = View();
+    auto bucket = tx.UserBucket();
+    for (int i = 0; i < count; ++i) {
+        auto iter = bucket.Get(std::to_string(i));
+        ASSERT_NE(iter, bucket.end());
+        ASSERT_EQ(iter.value(), std::string(1000, 'v'));
+    }
+}
+
+TEST_F(DBTest, FirstCommitReopen) {
+    // The first commit of a new file must not tie with the txid of the stale meta
+    {
+        auto tx = Update();
+        tx.UserBucket().Put("key", "value");
+        tx.Commit();
+    }
+    db_.reset();
+    db_ = atomkv::DB::Open({ .max_wal_size = 1024 * 1024 * 64 }, "Z:/db_test.ydb");
+    ASSERT_FALSE(!db_);
+    auto tx = View();
+    auto bucket = tx.UserBucket();
+    auto iter = bucket.Get("key");
+    ASSERT_NE(iter, bucket.end());
+    ASSERT_EQ(iter.value(), "value");
+}
+
+TEST_F(DBTest, OpenVersion1File) {
+    {
+        auto tx = Update();
+        auto bucket = tx.UserBucket();
+        for (int i = 0; i < 1000; ++i) {
+            bucket.Put(std::to_string(i), std::string(100, 'v'));
+        }
+        tx.Commit();
+    }
+    db_.reset();
+
+    // Rewrite both metas in the layout of version 1, which never saved the free list
+    auto rewrite_metas = [](auto&& convert) {
+        std::fstream file("Z:/db_test.ydb", std::ios::in | std::ios::out | std::ios::binary);
+        MetaStruct meta;
+        file.read(reinterpret_cast<char*>(&meta), kMetaSize);
+        const auto page_size = meta.page_size;
+        for (int i = 0; i < 2; ++i) {
+            file.seekg(i * page_size);
+            file.read(reinterpret_cast<char*>(&meta), kMetaSize);
+            file.seekp(i * page_size);
+            convert(meta, file);
+        }
+    };
+    rewrite_metas([](const MetaStruct& meta, std::fstream& file) {
+        MetaStructV1 old_meta{
+            .sign = meta.sign,
+            .page_size = meta.page_size,
+            .min_version = 1,
+            .page_count = meta.page_count,
+            .user_root = meta.user_root,
+            .free_list_pgid = kPageInvalidId,
+            .free_pair_count = 0,
+            .free_list_page_count = 0,
+            .txid = meta.txid,
+            .crc32 = 0,
+        };
+        wal::Crc32 crc32;
+        crc32.Append(&old_meta, kMetaV1Size - sizeof(uint32_t));
+        old_meta.crc32 = crc32.End();
+        file.write(reinterpret_cast<const char*>(&old_meta), kMetaV1Size);
+    });
+
+    auto check = [&](int count) {
+        auto tx = View();
+        auto bucket = tx.UserBucket();
+        for (int i = 0; i < count; ++i) {
+            auto iter = bucket.Get(std::to_string(i));
+            ASSERT_NE(iter, bucket.end());
+            ASSERT_EQ(iter.value(), std::string(100, 'v'));
+        }
+    };
+    db_ = atomkv::DB::Open({ .max_wal_size = 1024 * 1024 * 64 }, "Z:/db_test.ydb");
+    check(1000);
+    // The first commit saves the new layout next to the old one
+    {
+        auto tx = Update();
+        auto bucket = tx.UserBucket();
+        for (int i = 1000; i < 2000; ++i) {
+            bucket.Put(std::to_string(i), std::string(100, 'v'));
+        }
+        tx.Commit();
+    }
+    db_.reset();
+    db_ = atomkv::DB::Open({ .max_wal_size = 1024 * 1024 * 64 }, "Z:/db_test.ydb");
+    check(2000);
+    db_.reset();
+
+    // A file written by a later version is refused
+    rewrite_metas([](MetaStruct meta, std::fstream& file) {
+        meta.min_version = ATOMKV_VERSION + 1;
+        file.write(reinterpret_cast<const char*>(&meta), kMetaSize);
+    });
+    ASSERT_THROW(atomkv::DB::Open({ .max_wal_size = 1024 * 1024 * 64 }, "Z:/db_test.ydb"), std::runtime_error);
+    Open();
+}
+
+TEST_F(DBTest, Geometry) {
+    db_.reset();
+    const size_t page_size = 4096;
+    Open({
+        .page_size = page_size,
+        .initial_size = page_size * 64,
+        .growth_step = page_size * 64,
+        .max_size = page_size * 512,
+        .shrink_threshold = page_size * 32,
+    });
+    ASSERT_EQ(FileSize(), page_size * 64);
+
+    // The file grows by steps
+    int count = 0;
+    for (; FileSize() < page_size * 256; ++count) {
+        auto tx = Update();
+        auto bucket = tx.UserBucket();
+        bucket.Put(std::to_string(count), std::string(1000, 'v'));
+        tx.Commit();
+        ASSERT_EQ(FileSize() % (page_size * 64), 0);
+    }
+
+    {
+        auto tx = Update();
+        auto bucket = tx.UserBucket();
+        for (int i = 0; i < count; ++i) {
+            ASSERT_TRUE(bucket.Delete(std::to_string(i)));
+        }
+        tx.Commit();
+    }
+    // The freed pages are released by the following commits, then the tail is truncated
+    for (int i = 0; i < 5; ++i) {
+        auto tx = Update();
+        tx.UserBucket().Put("k", "v");
+        tx.Commit();
+    }
+    ASSERT_LT(FileSize(), page_size * 256);
+    ASSERT_GE(FileSize(), page_size * 64);
+
+    // But never beyond the maximum size
+    ASSERT_THROW({
+        for (int i = 0;; ++i) {
+            auto tx = Update();
+            auto bucket = tx.UserBucket();
+            bucket.Put(std::to_string(i), std::string(1000, 'v'));
+            tx.Commit();
+        }
+    }, std::runtime_error);
+    ASSERT_EQ(FileSize(), page_size * 512);
+
+    auto tx = View();
+    auto bucket = tx.UserBucket();
+    ASSERT_EQ(bucket.Get("k").value(), "v");
+}
+
+TEST_F(DBTest, SequentialScan) {
+    db_.reset();
+    Open({ .max_wal_size = 1024 * 1024 * 64, .mmap_advice = MmapAdvice::kRandom, .huge_pages = true });
+
+    {
+        auto tx = Update();
+        auto bucket = tx.UserBucket();
+        for (int i = 0; i < 10000; ++i) {
+            bucket.Put(std::to_string(10000 + i), std::to_string(i));
+        }
+        tx.Commit();
+    }
+
+    auto tx = View();
+    auto bucket = tx.UserBucket();
+    auto iter = bucket.begin();
+    iter.set_sequential(true);
+    auto copy = iter;
+    int i = 0;
+    for (; iter != bucket.end(); ++iter, ++i) {
+        ASSERT_EQ(iter.value(), std::to_string(i));
+    }
+    ASSERT_EQ(i, 10000);
+    iter.set_sequential(false);
+    ASSERT_EQ(copy.value(), "0");
+}
+
+TEST_F(DBTest, KeyPrefix) {
+    db_.reset();
+    Open({ .max_wal_size = 1024 * 1024 * 64, .key_prefix = true });
+
+    // Short keys and keys sharing the same prefix
+    srand(seed_);
+    std::map<std::string, std::string> map;
+    for (int round = 0; round < 4; ++round) {
+        auto tx = Update();
+        auto bucket = tx.UserBucket();
+        for (int i = 0; i < 20000; ++i) {
+            auto key = std::string(rand() % 2 ? "pref" : "pr") + RandomString(0, 8);
+            if (rand() % 4 == 0) {
+                ASSERT_EQ(bucket.Delete(key), map.erase(key) == 1);
+            } else {
+                bucket.Put(key, key);
+                map[key] = key;
+            }
+        }
+        tx.Commit();
+    }
+
+    auto tx = View();
+    auto bucket = tx.UserBucket();
+    for (auto& [key, value] : map) {
+        auto iter = bucket.Get(key);
+        ASSERT_NE(iter, bucket.end());
+        ASSERT_EQ(iter.value(), value);
+    }
+    ASSERT_EQ(bucket.Get("pq"), bucket.end());
+    ASSERT_EQ(bucket.Get("pref{"), bucket.end());
+
+    auto map_iter = map.begin();
+    for (auto iter = bucket.begin(); iter != bucket.end(); ++iter, ++map_iter) {
+        ASSERT_NE(map_iter, map.end());
+        ASSERT_EQ(iter.key(), map_iter->first);
+    }
+    ASSERT_EQ(map_iter, map.end());
+}
+
+TEST_F(DBTest, FormatFlags) {
+    db_.reset();
+    Open({ .max_wal_size = 1024 * 1024 * 64, .key_prefix = true, .prefix_compression = true });
+    {
+        auto tx = Update();
+        auto bucket = tx.UserBucket();
+        bucket.Put("key", "value");
+        tx.Commit();
+    }
+    db_.reset();
+
+    // Binaries before the flags existed must refuse the file
+    std::fstream file("Z:/db_test.ydb", std::ios::in | std::ios::out | std::ios::binary);
+    MetaStruct meta;
+    file.read(reinterpret_cast<char*>(&meta), kMetaSize);
+    ASSERT_EQ(meta.flags, kMetaFlagKeyPrefix | kMetaFlagPrefixCompression);
+    ASSERT_GT(meta.min_version, 1);
+
+    // A flag of a later version
+    for (int i = 0; i < 2; ++i) {
+        file.seekg(i * meta.page_size);
+        file.read(reinterpret_cast<char*>(&meta), kMetaSize);
+        meta.flags |= 1 << 31;
+        wal::Crc32 crc32;
+        crc32.Append(&meta, kMetaSize - sizeof(uint32_t));
+        meta.crc32 = crc32.End();
+        file.seekp(i * meta.page_size);
+        file.write(reinterpret_cast<const char*>(&meta), kMetaSize);
+    }
+    file.close();
+    ASSERT_THROW(atomkv::DB::Open({ .max_wal_size = 1024 * 1024 * 64 }, "Z:/db_test.ydb"), std::runtime_error);
+    Open();
+}
+
+TEST_F(DBTest, PrefixCompression) {
+    db_.reset();
+    Open({ .max_wal_size = 1024 * 1024 * 64, .key_prefix = true, .prefix_compression = true });
+
+    // Path-like keys sharing long prefixes, a few of them long enough for overflow pages
+    srand(seed_);
+    std::map<std::string, std::string> map;
+    for (int round = 0; round < 4; ++round) {
+        auto tx = Update();
+        auto bucket = tx.UserBucket();
+        for (int i = 0; i < 20000; ++i) {
+            auto key = "/tenant/" + std::to_string(rand() % 8) + "/user/" + RandomString(0, 6);
+            if (rand() % 500 == 0) {
+                key += RandomString(3000, 3000);
+            }
+            if (rand() % 4 == 0) {
+                ASSERT_EQ(bucket.Delete(key), map.erase(key) == 1);
+            } else {
+                auto value = RandomString(0, 16);
+                bucket.Put(key, value);
+                map[key] = value;
+            }
+        }
+        tx.Commit();
+    }
+
+    {
+        auto tx = View();
+        auto bucket = tx.UserBucket();
+        for (auto& [key, value] : map) {
+            auto iter = bucket.Get(key);
+            ASSERT_NE(iter, bucket.end());
+            ASSERT_EQ(iter.key(), key);
+            ASSERT_EQ(iter.value(), value);
+        }
+        ASSERT_EQ(bucket.Get("/tenant/"), bucket.end());
+        ASSERT_EQ(bucket.Get("/tenant/9"), bucket.end());
+
+        auto map_iter = map.begin();
+        for (auto iter = bucket.begin(); iter != bucket.end(); ++iter, ++map_iter) {
+            ASSERT_NE(map_iter, map.end());
+            // The key stays valid until the iterator moves, other iterators on the node keep their own
+            auto key = iter.key();
+            auto next = iter;
+            if (++next != bucket.end()) {
+                next.key();
+            }
+            iter.value();
+            ASSERT_EQ(iter.key().data(), key.data());
+            ASSERT_EQ(key, map_iter->first);
+        }
+        ASSERT_EQ(map_iter, map.end());
+    }
+
+    // The flag is persisted, the reopened tree must decode the compressed nodes
+    db_.reset();
+    db_ = atomkv::DB::Open({ .max_wal_size = 1024 * 1024 * 64 }, "Z:/db_test.ydb");
+    auto tx = View();
+    auto bucket = tx.UserBucket();
+    for (auto& [key, value] : map) {
+        auto iter = bucket.Get(key);
+        ASSERT_NE(iter, bucket.end());
+        ASSERT_EQ(iter.value(), value);
+    }
+}
+
 TEST_F(DBTest, EmptyKey) {
     auto tx = Update();
     auto bucket = tx.UserBucket();
@@ -204,6 +675,639 @@ TEST_F(DBTest, Delete) {
     tx.Commit();
 }
 
+TEST_F(DBTest, MultiGet) {
+    srand(seed_);
+    std::map<std::string, std::string> map;
+    {
+        auto tx = Update();
+        auto bucket = tx.UserBucket();
+        std::vector<std::string_view> keys{ "a", "b" };
+        auto values = bucket.MultiGet(keys);
+        ASSERT_EQ(values.size(), 2);
+        ASSERT_FALSE(values[0].has_value());
+        ASSERT_FALSE(values[1].has_value());
+
+        for (int i = 0; i < 50000; ++i) {
+            auto key = RandomString(1, 16);
+            auto value = RandomString(0, 100);
+            bucket.Put(key, value);
+            map[key] = value;
+        }
+        map[RandomString(4096, 4096)] = RandomString(8192, 8192);
+        bucket.Put(map.rbegin()->first, map.rbegin()->second);
+        bucket.SubUpdateBucket("sub");
+        map.erase("sub");
+        tx.Commit();
+    }
+
+    std::vector<std::string> map_keys;
+    for (auto& [key, value] : map) {
+        map_keys.push_back(key);
+    }
+
+    auto tx = View();
+    auto bucket = tx.UserBucket();
+    for (int round = 0; round < 100; ++round) {
+        // Unsorted, repeated and missing keys
+        std::vector<std::string> key_strs;
+        for (int i = 0; i < 200; ++i) {
+            if (rand() % 2 == 0) {
+                key_strs.push_back(map_keys[rand() % map_keys.size()]);
+            } else {
+                key_strs.push_back(RandomString(1, 16));
+            }
+        }
+        key_strs.push_back(key_strs[0]);
+        key_strs.push_back("sub");
+        std::vector<std::string_view> keys(key_strs.begin(), key_strs.end());
+        auto values = bucket.MultiGet(keys);
+        ASSERT_EQ(values.size(), keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            auto iter = map.find(key_strs[i]);
+            if (iter == map.end()) {
+                ASSERT_FALSE(values[i].has_value());
+            } else {
+                ASSERT_TRUE(values[i].has_value());
+                ASSERT_EQ(*values[i], iter->second);
+            }
+        }
+    }
+}
+
+TEST_F(DBTest, LowerBound) {
+    auto tx = Update();
+    auto bucket = tx.UserBucket();
+    auto make_key = [](int i) {
+        char buf[16];
+        std::snprintf(buf, sizeof(buf), "%08d", i);
+        return std::string(buf);
+    };
+    for (int i = 0; i < 20000; i += 2) {
+        bucket.Put(make_key(i), std::to_string(i));
+    }
+    // Every odd key lies between two stored keys, some of them past the last key of a leaf
+    for (int i = 1; i < 19999; i += 2) {
+        auto iter = bucket.LowerBound(make_key(i));
+        ASSERT_NE(iter, bucket.end());
+        ASSERT_EQ(iter.key(), make_key(i + 1));
+    }
+    ASSERT_EQ(bucket.LowerBound(make_key(19999)), bucket.end());
+}
+
+TEST_F(DBTest, HintedPutAndDelete) {
+    srand(seed_);
+    std::map<std::string, std::string> map;
+    {
+        auto tx = Update();
+        auto bucket = tx.UserBucket();
+        for (int i = 0; i < 20000; ++i) {
+            auto key = RandomString(4, 16);
+            bucket.Put(key, key);
+            map[key] = key;
+        }
+        tx.Commit();
+    }
+
+    auto tx = Update();
+    auto bucket = tx.UserBucket();
+    auto sub_bucket = bucket.SubUpdateBucket("sub");
+    map["sub"];
+    for (int i = 0; i < 20000; ++i) {
+        // Read-modify-write around the hint, the hints may be stale or belong to other buckets
+        auto key = RandomString(4, 16);
+        auto hint = bucket.LowerBound(key);
+        if (hint != bucket.end() && hint.key() != "sub") {
+            auto near_key = std::string(hint.key());
+            auto value = std::string(hint.value()) + "+";
+            bucket.Put(hint, near_key, value);
+            map[near_key] = value;
+        }
+        switch (rand() % 4) {
+        case 0:
+            ASSERT_EQ(bucket.Delete(hint, key), map.erase(key) == 1);
+            break;
+        case 1:
+            bucket.Put(sub_bucket.begin(), key, key);
+            map[key] = key;
+            break;
+        default:
+            bucket.Put(hint, key, key);
+            map[key] = key;
+            break;
+        }
+    }
+
+    auto map_iter = map.begin();
+    for (auto iter = bucket.begin(); iter != bucket.end(); ++iter, ++map_iter) {
+        ASSERT_NE(map_iter, map.end());
+        ASSERT_EQ(iter.key(), map_iter->first);
+        if (!iter.is_bucket()) {
+            ASSERT_EQ(iter.value(), map_iter->second);
+        }
+    }
+    ASSERT_EQ(map_iter, map.end());
+    tx.Commit();
+}
+
+TEST_F(DBTest, WriteBatch) {
+    srand(seed_);
+    std::map<std::string, std::string> map;
+    for (int round = 0; round < 8; ++round) {
+        auto tx = Update();
+        auto bucket = tx.UserBucket();
+        atomkv::WriteBatch batch;
+        for (int i = 0; i < 10000; ++i) {
+            // Short keys repeat within the batch, the last write wins
+            auto key = RandomString(1, 4);
+            if (rand() % 3 == 0) {
+                batch.Delete(key);
+                map.erase(key);
+            } else {
+                auto value = RandomString(0, 2000);
+                batch.Put(key, value);
+                map[key] = value;
+            }
+        }
+        ASSERT_EQ(batch.count(), 10000);
+        bucket.Write(batch);
+        tx.Commit();
+    }
+
+    auto tx = View();
+    auto bucket = tx.UserBucket();
+    auto map_iter = map.begin();
+    for (auto iter = bucket.begin(); iter != bucket.end(); ++iter, ++map_iter) {
+        ASSERT_NE(map_iter, map.end());
+        ASSERT_EQ(iter.key(), map_iter->first);
+        ASSERT_EQ(iter.value(), map_iter->second);
+    }
+    ASSERT_EQ(map_iter, map.end());
+}
+
+TEST_F(DBTest, CorruptedWriteBatch) {
+    db_.reset();
+    Open({ .mode = DbMode::kWal, .max_wal_size = 1024 * 1024 * 64 });
+    {
+        auto tx = Update();
+        auto& bucket = static_cast<DBImpl*>(db_.get())->tx_manager().update_tx().user_bucket();
+        const uint8_t corrupted[] = { 0xff, 1, 0, 0, 0, 'k' };
+        ASSERT_THROW(bucket.Write(corrupted), std::invalid_argument);
+        tx.UserBucket().Put("key", "value");
+        tx.Commit();
+    }
+
+    // Recovery replays the log as of the commit, the rejected batch must not be in it
+    const std::string path = "Z:/db_test.ydb";
+    std::filesystem::copy_file(path, path + ".bak", std::filesystem::copy_options::overwrite_existing);
+    std::filesystem::copy_file(path + "-wal", path + "-wal.bak", std::filesystem::copy_options::overwrite_existing);
+    db_.reset();
+    std::filesystem::rename(path + ".bak", path);
+    std::filesystem::rename(path + "-wal.bak", path + "-wal");
+    db_ = atomkv::DB::Open({ .mode = DbMode::kWal, .max_wal_size = 1024 * 1024 * 64 }, path);
+    ASSERT_FALSE(!db_);
+    auto tx = View();
+    auto bucket = tx.UserBucket();
+    ASSERT_EQ(bucket.Get("key").value(), "value");
+}
+
+TEST_F(DBTest, BulkLoad) {
+    srand(seed_);
+    for (auto fill_factor : { 1.0, 0.7 }) {
+        std::map<std::string, std::string> map;
+        for (int i = 0; i < 20000; ++i) {
+            map[RandomString(4, 16)] = RandomString(0, 100);
+        }
+        map[RandomString(4096, 4096)] = RandomString(8192, 8192);
+
+        {
+            auto tx = Update();
+            auto bucket = tx.UserBucket();
+            auto loader = bucket.BulkLoad(fill_factor);
+            for (auto& [key, value] : map) {
+                loader.Add(key, value);
+            }
+            ASSERT_THROW(loader.Add(map.begin()->first, "unsorted"), std::invalid_argument);
+            // The bucket cannot be used until the load is finished
+            ASSERT_THROW(bucket.Put("key", "value"), std::runtime_error);
+            ASSERT_THROW(bucket.Get(map.begin()->first), std::runtime_error);
+            ASSERT_THROW(bucket.Delete(map.begin()->first), std::runtime_error);
+            loader.Finish();
+            ASSERT_THROW(bucket.BulkLoad(fill_factor), std::invalid_argument);
+
+            // The loaded tree takes ordinary writes
+            for (int i = 0; i < 2000; ++i) {
+                auto key = RandomString(4, 16);
+                if (rand() % 2 == 0) {
+                    auto value = RandomString(0, 100);
+                    bucket.Put(key, value);
+                    map[key] = value;
+                } else {
+                    auto iter = map.begin();
+                    std::advance(iter, rand() % map.size());
+                    ASSERT_TRUE(bucket.Delete(iter->first));
+                    map.erase(iter);
+                }
+            }
+            tx.Commit();
+        }
+
+        auto check = [&] {
+            auto tx = View();
+            auto bucket = tx.UserBucket();
+            auto map_iter = map.begin();
+            for (auto iter = bucket.begin(); iter != bucket.end(); ++iter, ++map_iter) {
+                ASSERT_NE(map_iter, map.end());
+                ASSERT_EQ(iter.key(), map_iter->first);
+                ASSERT_EQ(iter.value(), map_iter->second);
+            }
+            ASSERT_EQ(map_iter, map.end());
+            for (auto& [key, value] : map) {
+                auto iter = bucket.Get(key);
+                ASSERT_NE(iter, bucket.end());
+                ASSERT_EQ(iter.value(), value);
+            }
+        };
+        check();
+
+        db_.reset();
+        db_ = atomkv::DB::Open({ .max_wal_size = 1024 * 1024 * 64 }, "Z:/db_test.ydb");
+        ASSERT_FALSE(!db_);
+        check();
+
+        db_.reset();
+        Open();
+    }
+
+    // A load left open is finished by the commit, and the loader is detached with the transaction
+    std::optional<atomkv::BulkLoader> loader;
+    {
+        auto tx = Update();
+        auto bucket = tx.UserBucket().SubUpdateBucket("sub");
+        loader.emplace(bucket.BulkLoad());
+        for (int i = 0; i < 10000; ++i) {
+            loader->Add(std::to_string(100000 + i), std::to_string(i));
+        }
+        tx.Commit();
+    }
+    ASSERT_THROW(loader->Add("200000", "0"), std::runtime_error);
+    ASSERT_THROW(loader->Finish(), std::runtime_error);
+    loader.reset();
+    {
+        auto tx = Update();
+        auto bucket = tx.UserBucket().SubUpdateBucket("sub2");
+        bucket.BulkLoad().Add("key", "value");
+        tx.Commit();
+    }
+    auto check = [&] {
+        auto tx = View();
+        auto bucket = tx.UserBucket().SubViewBucket("sub");
+        int count = 0;
+        for (auto iter = bucket.begin(); iter != bucket.end(); ++iter, ++count) {
+            ASSERT_EQ(iter.key(), std::to_string(100000 + count));
+            ASSERT_EQ(iter.value(), std::to_string(count));
+        }
+        ASSERT_EQ(count, 10000);
+        ASSERT_EQ(tx.UserBucket().SubViewBucket("sub2").Get("key").value(), "value");
+    };
+    check();
+    db_.reset();
+    db_ = atomkv::DB::Open({ .max_wal_size = 1024 * 1024 * 64 }, "Z:/db_test.ydb");
+    ASSERT_FALSE(!db_);
+    check();
+}
+
+TEST_F(DBTest, DeleteRange) {
+    srand(seed_);
+    std::map<std::string, std::string> map;
+    auto put_random = [&](atomkv::UpdateBucket& bucket, int count) {
+        for (int i = 0; i < count; ++i) {
+            auto key = RandomString(1, 8);
+            if (rand() % 1000 == 0) {
+                key += RandomString(3000, 3000);
+            }
+            auto value = RandomString(0, 100);
+            if (rand() % 1000 == 0) {
+                value = RandomString(8192, 8192);
+            }
+            bucket.Put(key, value);
+            map[key] = value;
+        }
+    };
+    auto check = [&] {
+        auto tx = View();
+        auto bucket = tx.UserBucket();
+        auto map_iter = map.begin();
+        for (auto iter = bucket.begin(); iter != bucket.end(); ++iter, ++map_iter) {
+            ASSERT_NE(map_iter, map.end());
+            ASSERT_EQ(iter.key(), map_iter->first);
+            ASSERT_EQ(iter.value(), map_iter->second);
+        }
+        ASSERT_EQ(map_iter, map.end());
+    };
+
+    for (int round = 0; round < 20; ++round) {
+        {
+            auto tx = Update();
+            auto bucket = tx.UserBucket();
+            put_random(bucket, 5000);
+            tx.Commit();
+        }
+        {
+            auto tx = Update();
+            auto bucket = tx.UserBucket();
+            for (int i = 0; i < 3; ++i) {
+                auto begin = RandomString(1, 3);
+                auto end = RandomString(1, 3);
+                bucket.DeleteRange(begin, end);
+                if (begin < end) {
+                    map.erase(map.lower_bound(begin), map.lower_bound(end));
+                }
+            }
+            // The tree takes writes after the cut
+            put_random(bucket, 500);
+            tx.Commit();
+        }
+        check();
+    }
+
+    // Sub buckets in the range are deleted with their trees, opened ones cannot be
+    {
+        auto tx = Update();
+        auto bucket = tx.UserBucket();
+        auto sub_bucket = bucket.SubUpdateBucket("m-sub");
+        for (int i = 0; i < 1000; ++i) {
+            sub_bucket.Put(RandomString(1, 8), RandomString(0, 100));
+        }
+        ASSERT_THROW(bucket.DeleteRange("m", "n"), std::invalid_argument);
+        tx.Commit();
+    }
+    {
+        auto tx = Update();
+        auto bucket = tx.UserBucket();
+        bucket.DeleteRange("m", "n");
+        map.erase(map.lower_bound("m"), map.lower_bound("n"));
+        tx.Commit();
+    }
+    check();
+
+    // Freed pages are reused by the same data
+    {
+        auto tx = Update();
+        auto bucket = tx.UserBucket();
+        bucket.DeleteRange("", "{");
+        tx.Commit();
+    }
+    {
+        auto tx = View();
+        auto bucket = tx.UserBucket();
+        ASSERT_EQ(bucket.begin(), bucket.end());
+    }
+    auto file_size = FileSize();
+    {
+        auto tx = Update();
+        auto bucket = tx.UserBucket();
+        for (auto& [key, value] : map) {
+            bucket.Put(key, value);
+        }
+        tx.Commit();
+    }
+    check();
+    ASSERT_EQ(FileSize(), file_size);
+}
+
+TEST_F(DBTest, CommitAsync) {
+    auto db_impl = static_cast<DBImpl*>(db_.get());
+    auto& pager = db_impl->pager();
+    auto& tx_manager = db_impl->tx_manager();
+    std::map<TxId, std::vector<std::pair<PageId, PageCount>>> freed_pages;
+    std::vector<std::future<void>> durable;
+    for (int n = 0; n < 100; ++n) {
+        auto tx = Update();
+        // Read after the pages were released, a later value only makes the check weaker
+        const auto persisted_txid = tx_manager.persisted_txid();
+        auto bucket = tx.UserBucket();
+        for (int i = 0; i < 100; ++i) {
+            bucket.Put(std::to_string(i), std::to_string(n) + std::string(100, 'v'));
+        }
+
+        // Overwriting frees the pages of the previous version, they must not be reused before it is durable
+        for (auto& [txid, pages] : freed_pages) {
+            if (txid <= persisted_txid) {
+                continue;
+            }
+            for (auto& [free_pgid, free_count] : pages) {
+                for (auto& [pgid, count] : pager.dirty_pages()) {
+                    ASSERT_TRUE(pgid + count <= free_pgid || free_pgid + free_count <= pgid);
+                }
+            }
+        }
+        const auto txid = tx_manager.update_tx().txid();
+        auto iter = pager.pending_map().find(txid);
+        if (iter != pager.pending_map().end()) {
+            freed_pages[txid] = iter->second;
+        }
+        durable.push_back(tx.CommitAsync());
+
+        // Visible to readers once committed
+        auto view_tx = View();
+        auto view_bucket = view_tx.UserBucket();
+        ASSERT_EQ(view_bucket.Get("99").value(), std::to_string(n) + std::string(100, 'v'));
+    }
+    for (auto& future : durable) {
+        future.get();
+    }
+
+    db_.reset();
+    db_ = atomkv::DB::Open({ .max_wal_size = 1024 * 1024 * 64 }, "Z:/db_test.ydb");
+    auto view_tx = View();
+    auto view_bucket = view_tx.UserBucket();
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_EQ(view_bucket.Get(std::to_string(i)).value(), "99" + std::string(100, 'v'));
+    }
+}
+
+TEST_F(DBTest, CommitDirtyPages) {
+    auto db_impl = static_cast<DBImpl*>(db_.get());
+    std::map<std::string, std::string> map;
+    {
+        auto tx = Update();
+        auto bucket = tx.UserBucket();
+        for (int i = 0; i < 2000; ++i) {
+            auto key = std::to_string(i);
+            auto value = RandomString(16, 64);
+            bucket.Put(key, value);
+            map[key] = value;
+        }
+        auto long_value = RandomString(1024 * 64, 1024 * 64);
+        bucket.Put("long", long_value);
+        map["long"] = long_value;
+        tx.Commit();
+    }
+    {
+        // Gives the free map something to allocate from
+        auto tx = Update();
+        auto bucket = tx.UserBucket();
+        for (int i = 0; i < 2000; i += 3) {
+            bucket.Delete(std::to_string(i));
+            map.erase(std::to_string(i));
+        }
+        bucket.Delete("long");
+        map.erase("long");
+        tx.Commit();
+    }
+
+    // Copied leaves, overflow pages and the free list delta all go out with one commit
+    auto tx = Update();
+    auto bucket = tx.UserBucket();
+    for (int i = 1; i < 2000; i += 3) {
+        auto key = std::to_string(i);
+        auto value = RandomString(16, 64);
+        bucket.Put(key, value);
+        map[key] = value;
+    }
+    for (int i = 0; i < 4; ++i) {
+        auto key = "long" + std::to_string(i);
+        auto value = RandomString(1024 * 16, 1024 * 16);
+        bucket.Put(key, value);
+        map[key] = value;
+    }
+    for (int i = 2; i < 2000; i += 30) {
+        bucket.Delete(std::to_string(i));
+        map.erase(std::to_string(i));
+    }
+    ASSERT_FALSE(db_impl->pager().dirty_pages().empty());
+    tx.Commit();
+    ASSERT_NE(db_impl->meta().meta_struct().free_delta_pgid, kPageInvalidId);
+
+    db_.reset();
+    db_ = atomkv::DB::Open({ .max_wal_size = 1024 * 1024 * 64 }, "Z:/db_test.ydb");
+    {
+        auto view_tx = View();
+        auto view_bucket = view_tx.UserBucket();
+        auto iter = view_bucket.begin();
+        for (auto& [key, value] : map) {
+            ASSERT_NE(iter, view_bucket.end());
+            ASSERT_EQ(iter.key(), key);
+            ASSERT_EQ(iter.value(), value);
+            ++iter;
+        }
+        ASSERT_EQ(iter, view_bucket.end());
+    }
+
+    // The reloaded free list hands out pages that are not in use
+    {
+        auto tx = Update();
+        auto bucket = tx.UserBucket();
+        for (int i = 0; i < 2000; ++i) {
+            bucket.Put("new" + std::to_string(i), std::to_string(i));
+        }
+        tx.Commit();
+    }
+    auto view_tx = View();
+    auto view_bucket = view_tx.UserBucket();
+    for (auto& [key, value] : map) {
+        ASSERT_EQ(view_bucket.Get(key).value(), value);
+    }
+}
+
+TEST_F(DBTest, OptimisticUpdate) {
+    // Several transactions of this thread keep their snapshots open while one of them commits
+    db_.reset();
+    Open({ .max_wal_size = 1024 * 1024 * 64, .map_size = 1024 * 1024 * 64 });
+
+    {
+        auto tx = Update();
+        auto bucket = tx.UserBucket();
+        bucket.SubUpdateBucket("t1").Put("k", "0");
+        bucket.SubUpdateBucket("t2").Put("k", "0");
+        tx.Commit();
+    }
+
+    // Disjoint sub buckets
+    {
+        auto tx1 = db_->OptimisticUpdate();
+        auto tx2 = db_->OptimisticUpdate();
+        ASSERT_EQ(tx1.SubViewBucket("t1").Get("k").value(), "0");
+        tx1.SubWriteBatch("t1").Put("k", "1");
+        ASSERT_EQ(tx2.SubViewBucket("t2").Get("k").value(), "0");
+        tx2.SubWriteBatch("t2").Put("k", "1");
+        tx2.SubWriteBatch("t3").Put("k", "1");
+        ASSERT_TRUE(tx1.Commit());
+        ASSERT_TRUE(tx2.Commit());
+        ASSERT_THROW(tx1.Commit(), std::runtime_error);
+    }
+
+    // A sub bucket written by another transaction after the snapshot, whether read or written here
+    {
+        auto tx1 = db_->OptimisticUpdate();
+        auto tx2 = db_->OptimisticUpdate();
+        auto tx3 = db_->OptimisticUpdate();
+        tx1.SubWriteBatch("t1").Put("k", "2");
+        tx2.SubWriteBatch("t1").Delete("k");
+        tx2.SubWriteBatch("t2").Put("k", "2");
+        tx3.SubViewBucket("t1");
+        tx3.SubWriteBatch("t2").Put("k", "3");
+        ASSERT_TRUE(tx1.Commit());
+        ASSERT_FALSE(tx2.Commit());
+        ASSERT_FALSE(tx3.Commit());
+    }
+    {
+        auto tx = View();
+        auto bucket = tx.UserBucket();
+        ASSERT_EQ(bucket.SubViewBucket("t1").Get("k").value(), "2");
+        ASSERT_EQ(bucket.SubViewBucket("t2").Get("k").value(), "1");
+        ASSERT_EQ(bucket.SubViewBucket("t3").Get("k").value(), "1");
+    }
+
+    // A key value pair stored at a sub bucket that did not exist in the snapshot
+    {
+        auto tx1 = db_->OptimisticUpdate();
+        tx1.SubWriteBatch("p").Put("k", "1");
+        {
+            auto tx = Update();
+            tx.UserBucket().Put("p", "v");
+            tx.Commit();
+        }
+        ASSERT_FALSE(tx1.Commit());
+        auto tx = View();
+        auto bucket = tx.UserBucket();
+        ASSERT_EQ(bucket.Get("p").value(), "v");
+    }
+
+    // Each thread works on its own sub bucket, none of the commits conflict
+    std::vector<std::thread> writers;
+    std::atomic<int> conflicts = 0;
+    for (int t = 0; t < 4; ++t) {
+        writers.emplace_back([&, t] {
+            auto key = "w" + std::to_string(t);
+            for (int n = 0; n < 100; ++n) {
+                auto tx = db_->OptimisticUpdate();
+                auto& batch = tx.SubWriteBatch(key);
+                for (int i = 0; i < 10; ++i) {
+                    batch.Put(std::to_string(n * 10 + i), key);
+                }
+                if (!tx.Commit()) {
+                    ++conflicts;
+                }
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    ASSERT_EQ(conflicts, 0);
+    auto tx = View();
+    auto bucket = tx.UserBucket();
+    for (int t = 0; t < 4; ++t) {
+        auto sub_bucket = bucket.SubViewBucket("w" + std::to_string(t));
+        int count = 0;
+        for (auto iter = sub_bucket.begin(); iter != sub_bucket.end(); ++iter) {
+            ++count;
+        }
+        ASSERT_EQ(count, 1000);
+    }
+}
+
 TEST_F(DBTest, PutLongData) {
     auto long_key1 = RandomString(4096, 4096);
     auto long_value1 = RandomString(1024 * 1024, 1024 * 1024);
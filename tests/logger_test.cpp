@@ -7,6 +7,8 @@
 //
 //THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
+#include <thread>
+
 #include <gtest/gtest.h>
 
 #include "src/db_impl.h"
@@ -24,16 +26,22 @@ public:
         Open();
     }
 
-    void Open() {
+    void Open(size_t max_wal_size = 1024 * 1024 * 64, bool clear = true, bool sync = false, size_t map_size = 0) {
         atomkv::Options options{
-            .max_wal_size = 1024 * 1024 * 64,
+            .sync = sync,
+            .mode = DbMode::kWal,
+            .max_wal_size = max_wal_size,
+            .map_size = map_size,
         };
         db_.reset();
         //std::string path = testing::TempDir() + "pager_test.ydb";
         const std::string path = "Z:/logger_test.ydb";
-        std::filesystem::remove(path);
-        std::filesystem::remove(path + "-shm");
-        std::filesystem::remove(path + "-wal");
+        if (clear) {
+            std::filesystem::remove(path);
+            std::filesystem::remove(path + "-shm");
+            std::filesystem::remove(path + "-wal");
+            std::filesystem::remove(path + "-wal2");
+        }
         db_ = atomkv::DB::Open(options, path);
         ASSERT_FALSE(!db_);
 
@@ -45,12 +53,74 @@ public:
 };
 
 TEST_F(LoggerTest, CheckPoint) {
+    auto tx = db_->Update();
     logger_->Checkpoint();
+    tx.Commit();
+}
+
+TEST_F(LoggerTest, AsyncCheckPoint) {
+    Open(4096);
+    auto db_impl = static_cast<DBImpl*>(db_.get());
+    auto& tx_manager = db_impl->tx_manager();
+    auto persisted_txid = tx_manager.persisted_txid();
+    for (int i = 0; i < 1000; ++i) {
+        auto tx = db_->Update();
+        auto bucket = tx.UserBucket();
+        bucket.Put("key" + std::to_string(i), "value" + std::to_string(i));
+        tx.Commit();
+    }
+    logger_->WaitCheckpoint();
+    ASSERT_GT(tx_manager.persisted_txid(), persisted_txid);
+
+    Open(4096, false);
+    auto tx = db_->View();
+    auto bucket = tx.UserBucket();
+    for (int i = 0; i < 1000; ++i) {
+        auto iter = bucket.Get("key" + std::to_string(i));
+        ASSERT_NE(iter, bucket.end());
+        ASSERT_EQ(iter.value(), "value" + std::to_string(i));
+    }
 }
 
 TEST_F(LoggerTest, Recover) {
     logger_->Recover();
 }
 
+TEST_F(LoggerTest, GroupCommit) {
+    // The views read while other threads commit, the reserved mapping is never moved under them
+    Open(1024 * 1024 * 64, true, true, 1024 * 1024 * 64);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([this, t]() {
+            for (int i = 0; i < 200; ++i) {
+                auto tx = db_->Update();
+                auto bucket = tx.UserBucket();
+                bucket.Put("key" + std::to_string(t) + "_" + std::to_string(i), std::to_string(i));
+                tx.Commit();
+
+                // Published once synced, before Commit returns
+                auto view = db_->View();
+                auto view_bucket = view.UserBucket();
+                ASSERT_NE(view_bucket.Get("key" + std::to_string(t) + "_" + std::to_string(i)), view_bucket.end());
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    // Commits that flushed while a sync was in progress share the next one
+    ASSERT_LT(logger_->sync_count(), 4 * 200);
+
+    Open(1024 * 1024 * 64, false, true, 1024 * 1024 * 64);
+    auto tx = db_->View();
+    auto bucket = tx.UserBucket();
+    for (int t = 0; t < 4; ++t) {
+        for (int i = 0; i < 200; ++i) {
+            auto iter = bucket.Get("key" + std::to_string(t) + "_" + std::to_string(i));
+            ASSERT_NE(iter, bucket.end());
+            ASSERT_EQ(iter.value(), std::to_string(i));
+        }
+    }
+}
 
 } // namespace atomkv
\ No newline at end of file
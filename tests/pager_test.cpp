@@ -26,16 +26,18 @@ public:
         Open();
     }
 
-    void Open() {
+    void Open(bool clear = true) {
         atomkv::Options options{
             .max_wal_size = 1024 * 1024 * 64,
         };
         db_.reset();
         //std::string path = testing::TempDir() + "pager_test.ydb";
         const std::string path = "Z:/pager_test.ydb";
-        std::filesystem::remove(path);
-        std::filesystem::remove(path + "-shm");
-        std::filesystem::remove(path + "-wal");
+        if (clear) {
+            std::filesystem::remove(path);
+            std::filesystem::remove(path + "-shm");
+            std::filesystem::remove(path + "-wal");
+        }
         db_ = atomkv::DB::Open(options, path);
         ASSERT_FALSE(!db_);
 
@@ -44,6 +46,19 @@ public:
         logger_ = &db_impl->logger();
     }
 
+    // Allocates single pages until the free map is exhausted, then rolls back
+    std::vector<PageId> AllocAllFree() {
+        auto db_impl = static_cast<DBImpl*>(db_.get());
+        auto tx = db_->Update();
+        const auto page_count = db_impl->meta().meta_struct().page_count;
+        std::vector<PageId> free_list;
+        for (auto pgid = pager_->Alloc(1); pgid < page_count; pgid = pager_->Alloc(1)) {
+            free_list.push_back(pgid);
+        }
+        tx.RollBack();
+        return free_list;
+    }
+
     std::span<const uint8_t> FromString(std::string_view str) {
         return { reinterpret_cast<const uint8_t*>(str.data()), str.size() };
     }
@@ -139,6 +154,54 @@ TEST_F(PagerTest, AllocAndFree) {
     }
 }
 
+TEST_F(PagerTest, AllocBestFit) {
+    PageId base;
+    {
+        auto tx = db_->Update();
+        base = pager_->Alloc(24);
+        tx.Commit();
+    }
+    {
+        // Leave holes of 5, 1, 3 and 9 pages, the last one freed in pieces
+        auto tx = db_->Update();
+        pager_->Free(base + 0, 5);
+        pager_->Free(base + 6, 1);
+        pager_->Free(base + 8, 3);
+        pager_->Free(base + 16, 2);
+        pager_->Free(base + 12, 2);
+        pager_->Free(base + 18, 3);
+        pager_->Free(base + 14, 2);
+        tx.Commit();
+    }
+    // Wait until the pending pages are released
+    for (int i = 0; i < 2; ++i) {
+        auto tx = db_->Update();
+        tx.Commit();
+    }
+    {
+        auto tx = db_->Update();
+        auto pgid = pager_->Alloc(3);
+        ASSERT_EQ(pgid, base + 8);
+        pgid = pager_->Alloc(1);
+        ASSERT_EQ(pgid, base + 6);
+        pgid = pager_->Alloc(9);
+        ASSERT_EQ(pgid, base + 12);
+        pgid = pager_->Alloc(5);
+        ASSERT_EQ(pgid, base + 0);
+        tx.RollBack();
+    }
+    {
+        auto tx = db_->Update();
+        auto pgid = pager_->Alloc(4);
+        ASSERT_EQ(pgid, base + 0);
+        pgid = pager_->Alloc(5);
+        ASSERT_EQ(pgid, base + 12);
+        pgid = pager_->Alloc(4);
+        ASSERT_EQ(pgid, base + 17);
+        tx.RollBack();
+    }
+}
+
 TEST_F(PagerTest, FreeListSaveAndLoad) {
     {
         auto tx = db_->Update();
@@ -157,12 +220,43 @@ TEST_F(PagerTest, FreeListSaveAndLoad) {
         pager_->Free(4, 1);
         tx.Commit();
     }
+    Open(false);
     {
-
+        auto tx = db_->Update();
+        auto pgid = pager_->Alloc(3);
+        ASSERT_EQ(pgid, 2);
+        tx.Commit();
     }
-    pager_->SaveFreeList();
 
+    // Enough commits for the deltas to be rewritten into a whole list several times
+    std::vector<std::pair<PageId, PageCount>> extents;
+    for (uint32_t i = 0; i < 200; ++i) {
+        auto tx = db_->Update();
+        const PageCount count = i % 7 + 1;
+        const auto pgid = pager_->Alloc(count);
+        if (i % 5 == 0) {
+            pager_->Free(pgid, count);
+            tx.RollBack();
+            continue;
+        }
+        extents.push_back({ pgid, count });
+        if (i % 3 != 0) {
+            const auto index = (i * 37) % extents.size();
+            pager_->Free(extents[index].first, extents[index].second);
+            extents.erase(extents.begin() + index);
+        }
+        tx.Commit();
+    }
+    // Wait until the pending pages are released
+    for (int i = 0; i < 2; ++i) {
+        auto tx = db_->Update();
+        tx.Commit();
+    }
+    const auto free_list = AllocAllFree();
+    ASSERT_FALSE(free_list.empty());
 
+    Open(false);
+    ASSERT_EQ(AllocAllFree(), free_list);
 }
 
 } // namespace atomkv
\ No newline at end of file
@@ -7,6 +7,7 @@
 //
 //THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
+#include <functional>
 #include <thread>
 
 #include <gtest/gtest.h>
@@ -26,9 +27,10 @@ public:
         Open();
     }
 
-    void Open() {
+    void Open(uint32_t max_readers = 128) {
         atomkv::Options options{
             .max_wal_size = 1024 * 1024 * 64,
+            .max_readers = max_readers,
         };
         db_.reset();
         //std::string path = testing::TempDir() + "pager_test.ydb";
@@ -95,4 +97,26 @@ TEST_F(TxManagerTest, TxExpired) {
 }
 
 
-} // namespace atomkv
\ No newline at end of file
+TEST_F(TxManagerTest, MaxReaders) {
+    // More than the 128 slots of the default
+    Open(300);
+    std::function<void(int)> open_views = [&](int count) {
+        if (count == 0) {
+            ASSERT_THROW(tx_manager_->View(), std::runtime_error);
+            return;
+        }
+        auto view_tx = tx_manager_->View();
+        open_views(count - 1);
+    };
+    open_views(300);
+
+    Open(2);
+    auto view_tx1 = tx_manager_->View();
+    {
+        auto view_tx2 = tx_manager_->View();
+        ASSERT_THROW(tx_manager_->View(), std::runtime_error);
+    }
+    auto view_tx3 = tx_manager_->View();
+}
+
+} // namespace atomkv